@@ -0,0 +1,120 @@
+#include "Biquad.h"
+#include <cmath>
+#include "FastMath.h"
+
+BiquadCoeffs biquadBypass()
+{
+    BiquadCoeffs c = { 1.f, 0.f, 0.f, 0.f, 0.f };
+    return c;
+}
+
+static float clampCutoff(float fc, float fs)
+{
+    if(fc < 10.f) fc = 10.f;
+    if(fc > 0.45f * fs) fc = 0.45f * fs;
+    return fc;
+}
+
+BiquadCoeffs biquadLowpass(float fc, float fs, float q)
+{
+    float w0 = 2.f * (float)M_PI * clampCutoff(fc, fs) / fs;
+    float cw = fast_cos(w0);
+    float alpha = fast_sin(w0) / (2.f * q);
+    float ia0 = 1.f / (1.f + alpha);
+
+    BiquadCoeffs c;
+    c.b0 = 0.5f * (1.f - cw) * ia0;
+    c.b1 = (1.f - cw) * ia0;
+    c.b2 = c.b0;
+    c.a1 = -2.f * cw * ia0;
+    c.a2 = (1.f - alpha) * ia0;
+    return c;
+}
+
+BiquadCoeffs biquadHighpass(float fc, float fs, float q)
+{
+    float w0 = 2.f * (float)M_PI * clampCutoff(fc, fs) / fs;
+    float cw = fast_cos(w0);
+    float alpha = fast_sin(w0) / (2.f * q);
+    float ia0 = 1.f / (1.f + alpha);
+
+    BiquadCoeffs c;
+    c.b0 = 0.5f * (1.f + cw) * ia0;
+    c.b1 = -(1.f + cw) * ia0;
+    c.b2 = c.b0;
+    c.a1 = -2.f * cw * ia0;
+    c.a2 = (1.f - alpha) * ia0;
+    return c;
+}
+
+void Biquad::smoothCoefficients(float amount)
+{
+    live.b0 += amount * (target.b0 - live.b0);
+    live.b1 += amount * (target.b1 - live.b1);
+    live.b2 += amount * (target.b2 - live.b2);
+    live.a1 += amount * (target.a1 - live.a1);
+    live.a2 += amount * (target.a2 - live.a2);
+}
+
+BiquadBank::BiquadBank()
+{
+    for(unsigned int lane = 0; lane < 4; lane++)
+        setSection(lane, biquadBypass());
+    snapToTarget();
+    reset();
+}
+
+void BiquadBank::setSection(unsigned int lane, const BiquadCoeffs& c)
+{
+    lane &= 3;
+    target[0][lane] = c.b0;
+    target[1][lane] = c.b1;
+    target[2][lane] = c.b2;
+    target[3][lane] = c.a1;
+    target[4][lane] = c.a2;
+}
+
+void BiquadBank::snapToTarget()
+{
+    b0 = vf4::load(target[0]);
+    b1 = vf4::load(target[1]);
+    b2 = vf4::load(target[2]);
+    a1 = vf4::load(target[3]);
+    a2 = vf4::load(target[4]);
+}
+
+// Interpolating the coefficients of a stable filter can briefly leave the
+// stable region for large jumps; small per-block steps keep that harmless.
+void BiquadBank::smoothCoefficients(float amount)
+{
+    vf4 k(amount);
+    b0 = b0 + k * (vf4::load(target[0]) - b0);
+    b1 = b1 + k * (vf4::load(target[1]) - b1);
+    b2 = b2 + k * (vf4::load(target[2]) - b2);
+    a1 = a1 + k * (vf4::load(target[3]) - a1);
+    a2 = a2 + k * (vf4::load(target[4]) - a2);
+}
+
+void BiquadBank::reset()
+{
+    s1 = vf4(0.f);
+    s2 = vf4(0.f);
+    lastOut = vf4(0.f);
+}
+
+void BiquadBank::processCascade(float* buf, unsigned int n, unsigned int sections)
+{
+    for(unsigned int i = 0; i < n; i++)
+        buf[i] = processCascadeSample(buf[i], sections);
+}
+
+void BiquadBank::processParallel(float* const channels[4], unsigned int n)
+{
+    for(unsigned int i = 0; i < n; i++) {
+        float x[4] = { channels[0][i], channels[1][i], channels[2][i], channels[3][i] };
+        float y[4];
+        step(vf4::load(x)).store(y);
+        for(unsigned int c = 0; c < 4; c++)
+            channels[c][i] = y[c];
+    }
+}
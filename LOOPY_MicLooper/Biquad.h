@@ -0,0 +1,94 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include "Simd.h"
+
+// One biquad section, normalised so that a0 == 1
+struct BiquadCoeffs {
+    float b0, b1, b2, a1, a2;
+};
+
+// RBJ cookbook designs. Frequencies are clamped to a safe range below Nyquist.
+BiquadCoeffs biquadBypass();
+BiquadCoeffs biquadLowpass(float fc, float fs, float q);
+BiquadCoeffs biquadHighpass(float fc, float fs, float q);
+
+// One biquad section in transposed direct form II, scalar. Two of them in
+// series (DelayEffect's damping) are cheaper than a two-section
+// BiquadBank cascade, which only pays off from three or four sections or
+// in parallel (bench filters), and add no latency. Same coefficient
+// smoothing as BiquadBank.
+class Biquad {
+public:
+    // inline, so that a local one's state can live in registers
+    Biquad() : s1(0.f), s2(0.f) { live = target = biquadBypass(); }
+
+    void setTarget(const BiquadCoeffs& c) { target = c; }
+    void snapToTarget() { live = target; }
+    void smoothCoefficients(float amount);
+    void reset() { s1 = s2 = 0.f; }
+
+    SIMD_INLINE float processSample(float x)
+    {
+        // the terms not waiting on y first: the recurrence through s1 is
+        // an add, a multiply and a subtract
+        float y = live.b0 * x + s1;
+        s1 = (live.b1 * x + s2) - live.a1 * y;
+        s2 = live.b2 * x - live.a2 * y;
+        return y;
+    }
+
+private:
+    BiquadCoeffs live;
+    BiquadCoeffs target;
+    float s1, s2;
+};
+
+// Four biquad sections, one per vf4 lane, in transposed direct form II.
+//
+// Cascade mode runs a series chain on one signal: every sample, lane k is
+// fed what lane k-1 produced on the previous sample, so a chain of up to
+// four sections costs one vector step per sample. The price is a latency
+// of (sections - 1) samples, reported by cascadeLatency().
+// Parallel mode runs the four lanes as independent channels.
+//
+// Coefficient changes go to a target set; smoothCoefficients() moves the
+// live coefficients towards it and is meant to be called once per block.
+class BiquadBank {
+public:
+    BiquadBank();
+
+    void setSection(unsigned int lane, const BiquadCoeffs& c);
+    void snapToTarget();
+    void smoothCoefficients(float amount);
+    void reset();
+
+    // One cascade step over `sections` lanes; returns the chain output
+    SIMD_INLINE float processCascadeSample(float in, unsigned int sections)
+    {
+        return vlane(step(vshift_in(lastOut, in)), sections - 1);
+    }
+    void processCascade(float* buf, unsigned int n, unsigned int sections);
+    static unsigned int cascadeLatency(unsigned int sections) { return sections > 0 ? sections - 1 : 0; }
+
+    // One sample of four independent channels
+    SIMD_INLINE vf4 processParallelSample(vf4 in) { return step(in); }
+    void processParallel(float* const channels[4], unsigned int n);
+
+private:
+    SIMD_INLINE vf4 step(vf4 x)
+    {
+        vf4 y = b0 * x + s1;
+        s1 = b1 * x - a1 * y + s2;
+        s2 = b2 * x - a2 * y;
+        lastOut = y;
+        return y;
+    }
+
+    vf4 b0, b1, b2, a1, a2;          // live coefficients
+    float target[5][4];              // per-lane targets, b0 b1 b2 a1 a2
+    vf4 s1, s2;
+    vf4 lastOut;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "DelayEffect.h"
-#include <cmath>   // floor, etc.
+#include "FastMath.h"   // fast_floor, etc.
+#include "NonFinite.h"
 
 DelayEffect::DelayEffect(unsigned int sr, float delayTimeSec, float feedbackAmount, unsigned int bufSize)
     : sampleRate(sr)
@@ -10,6 +11,16 @@ DelayEffect::DelayEffect(unsigned int sr, float delayTimeSec, float feedbackAmou
     , timeSmoothingFactor(0.01f) // default
     , feedback(0.5f)
     , mix(0.5f)
+    , feedbackStep(0.0f)
+    , mixStep(0.0f)
+    , feedbackRampFrames(0)
+    , mixRampFrames(0)
+    , dampingEnabled(false)
+    , saturationEnabled(false)
+    , saturationLag(0)
+    , silentRun(0)
+    , checkedPointer(0)
+    , recoveryCount(0)
 {
     delayBuffer.resize(bufferSize, 0.0f);
 
@@ -26,37 +37,100 @@ void DelayEffect::setDelayTime(float delayTimeSec) {
     targetDelayTimeInSamples = (float)samples;
 }
 
+void DelayEffect::setSampleRate(unsigned int sr) {
+    float seconds = targetDelayTimeInSamples / sampleRate;
+    sampleRate = sr;
+    setDelayTime(seconds);
+    currentDelayTimeInSamples = targetDelayTimeInSamples;
+}
+
 void DelayEffect::setFeedback(float feedbackAmount) {
     feedback = clampValue(feedbackAmount, 0.f, 1.f);
+    feedbackRampFrames = 0;
 }
 
 void DelayEffect::setMix(float mixAmount) {
     mix = clampValue(mixAmount, 0.f, 1.f);
+    mixRampFrames = 0;
 }
 
+void DelayEffect::rampFeedback(float feedbackAmount, unsigned int frames) {
+    if(frames == 0) {
+        setFeedback(feedbackAmount);
+        return;
+    }
+    feedbackStep = (clampValue(feedbackAmount, 0.f, 1.f) - feedback) / (float)frames;
+    feedbackRampFrames = frames;
+}
 
-float DelayEffect::processSample(float inputSample)
-{
-    // smooth transitions:
-    float diff = targetDelayTimeInSamples - currentDelayTimeInSamples;
-    currentDelayTimeInSamples += timeSmoothingFactor * diff;
+void DelayEffect::rampMix(float mixAmount, unsigned int frames) {
+    if(frames == 0) {
+        setMix(mixAmount);
+        return;
+    }
+    mixStep = (clampValue(mixAmount, 0.f, 1.f) - mix) / (float)frames;
+    mixRampFrames = frames;
+}
 
-    // ring buffer read position
-    float desiredRead = (float)writePointer - currentDelayTimeInSamples;
-    while(desiredRead < 0.f) desiredRead += (float)bufferSize;
-    while(desiredRead >= (float)bufferSize) desiredRead -= (float)bufferSize;
+void DelayEffect::setDamping(float lowpassHz, float highpassHz) {
+    const float q = 0.7071f;
+    dampingLowpass.setTarget(lowpassHz > 0.f ? biquadLowpass(lowpassHz, (float)sampleRate, q) : biquadBypass());
+    dampingHighpass.setTarget(highpassHz > 0.f ? biquadHighpass(highpassHz, (float)sampleRate, q) : biquadBypass());
 
-    int floorPos = (int)std::floor(desiredRead);
-    float frac = desiredRead - (float)floorPos;
-    int nextPos = (floorPos + 1) % bufferSize;
+    bool enable = lowpassHz > 0.f || highpassHz > 0.f;
+    if(enable && !dampingEnabled) {
+        // start from clean state and the exact new response
+        resetDamping();
+    }
+    dampingEnabled = enable;
+}
 
-    float delayedSample = (1.f - frac)*delayBuffer[floorPos] + frac*delayBuffer[nextPos];
+void DelayEffect::setSaturation(float ceiling, unsigned int oversampling) {
+    bool enable = ceiling > 0.f;
+    if(enable) {
+        if(!saturationEnabled)
+            saturator.reset();
+        saturator.setOversampling(oversampling);
+        saturator.setCeiling(ceiling);
+        saturationLag = (unsigned int)(saturator.latency() + 0.5f);
+    }
+    saturationEnabled = enable;
+}
+
+void DelayEffect::beginBlock() {
+    // only the slots written since the last call can have gone bad
+    unsigned int end = (writePointer + bufferSize - writeLag()) % bufferSize;
+    unsigned int count = (end + bufferSize - checkedPointer) % bufferSize;
+    if(scrub_ring(delayBuffer.data(), bufferSize, checkedPointer, count))
+        recover();
+    checkedPointer = end;
 
-    float output = (1.f - mix)*inputSample + mix*delayedSample;
+    if(dampingEnabled) {
+        dampingLowpass.smoothCoefficients(0.2f);
+        dampingHighpass.smoothCoefficients(0.2f);
+    }
+}
 
-    // write
-    delayBuffer[writePointer] = inputSample + delayedSample * feedback;
-    writePointer = (writePointer + 1) % bufferSize;
+// Clean filter state and the exact current response
+void DelayEffect::resetDamping() {
+    dampingLowpass.reset();
+    dampingLowpass.snapToTarget();
+    dampingHighpass.reset();
+    dampingHighpass.snapToTarget();
+}
 
-    return output;
-}
\ No newline at end of file
+// The buffer has been scrubbed; restart every piece of state the bad
+// values may have passed through
+void DelayEffect::recover() {
+    resetDamping();
+    saturator.reset();
+    if(!is_finite(targetDelayTimeInSamples))
+        targetDelayTimeInSamples = 0.f;
+    currentDelayTimeInSamples = targetDelayTimeInSamples;
+    feedback = is_finite(feedback) ? feedback : 0.f;
+    mix = is_finite(mix) ? mix : 0.5f;
+    feedbackRampFrames = 0;
+    mixRampFrames = 0;
+    silentRun = 0;
+    recoveryCount++;
+}
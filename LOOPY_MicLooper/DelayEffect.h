@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <algorithm>
+#include "Biquad.h"
+#include "FastMath.h"
+#include "Saturator.h"
 
 template <typename T>
 T clampValue(T value, T minVal, T maxVal) {
@@ -16,15 +19,50 @@ public:
     DelayEffect(unsigned int sr, float delayTimeSec, float feedbackAmount, unsigned int bufSize);
 
     void setDelayTime(float delayTimeSec);
+    // For a sample rate other than the constructor's; keeps the delay time
+    void setSampleRate(unsigned int sr);
     void setFeedback(float feedbackAmount);
     void setMix(float mixAmount);
 
+    // Move feedback / mix linearly to a new value over the next `frames`
+    // samples (e.g. one block), instead of jumping
+    void rampFeedback(float feedbackAmount, unsigned int frames);
+    void rampMix(float mixAmount, unsigned int frames);
+
     // optional smoothing factor if you want it
     void setTimeSmoothingFactor(float factor) { timeSmoothingFactor = clampValue(factor, 0.f, 1.f); }
 
+    // Low-pass / high-pass damping of the repeats; 0 Hz turns a filter off
+    void setDamping(float lowpassHz, float highpassHz);
+
+    // Soft saturation of everything written back into the line, bounding
+    // the repeats to +/- ceiling. oversampling is 1, 2 or 4; a ceiling of
+    // 0 turns it off.
+    void setSaturation(float ceiling, unsigned int oversampling);
+
+    // Once per audio block, before the first processSample(). Also checks
+    // what the previous block wrote for NaN/Inf and recovers from it.
+    void beginBlock();
+
+    // Size is the buffer size, if known when compiling (EngineConfig.h); it
+    // must then be the constructor's. The ring wraps become constant
+    // arithmetic instead of divisions. 0 reads it at run time.
+    template <unsigned int Size = 0>
     float processSample(float inputSample);
 
+    // True once a whole buffer length of (near) silence has been written:
+    // the repeats have died away, and with silent input the output is 0.
+    bool isIdle() const { return silentRun >= bufferSize; }
+
+    // Number of times non-finite values were found and cleared
+    unsigned int recoveries() const { return recoveryCount; }
+
 private:
+    // how far behind writePointer the filtered feedback is written
+    unsigned int writeLag() const { return saturationEnabled ? saturationLag : 0; }
+    void resetDamping();
+    void recover();
+
     unsigned int sampleRate;
     unsigned int bufferSize;
     unsigned int writePointer;
@@ -38,8 +76,82 @@ private:
     float feedback; 
     float mix;
 
+    // per-sample ramps towards the last ramp targets
+    float feedbackStep;
+    float mixStep;
+    unsigned int feedbackRampFrames;
+    unsigned int mixRampFrames;
+
+    // feedback damping, low-pass then high-pass
+    Biquad dampingLowpass;
+    Biquad dampingHighpass;
+    bool dampingEnabled;
+
+    // feedback saturation and its resampling delay, in whole samples
+    Saturator saturator;
+    bool saturationEnabled;
+    unsigned int saturationLag;
+
+    // consecutive near-silent writes, saturating at bufferSize
+    unsigned int silentRun;
+
+    // slots before this one have been checked for NaN/Inf
+    unsigned int checkedPointer;
+    unsigned int recoveryCount;
+
     // ring buffer
     std::vector<float> delayBuffer;
 };
 
-#endif
\ No newline at end of file
+template <unsigned int Size>
+inline float DelayEffect::processSample(float inputSample)
+{
+    const unsigned int size = Size ? Size : bufferSize;
+
+    // parameter ramps
+    if(feedbackRampFrames > 0) {
+        feedback += feedbackStep;
+        feedbackRampFrames--;
+    }
+    if(mixRampFrames > 0) {
+        mix += mixStep;
+        mixRampFrames--;
+    }
+
+    // smooth transitions:
+    float diff = targetDelayTimeInSamples - currentDelayTimeInSamples;
+    currentDelayTimeInSamples += timeSmoothingFactor * diff;
+
+    // ring buffer read position
+    float desiredRead = (float)writePointer - currentDelayTimeInSamples;
+    while(desiredRead < 0.f) desiredRead += (float)size;
+    while(desiredRead >= (float)size) desiredRead -= (float)size;
+
+    int floorPos = (int)fast_floor(desiredRead);
+    float frac = desiredRead - (float)floorPos;
+    int nextPos = (floorPos + 1) % size;
+
+    float delayedSample = (1.f - frac)*delayBuffer[floorPos] + frac*delayBuffer[nextPos];
+
+    float output = (1.f - mix)*inputSample + mix*delayedSample;
+
+    // write, through the saturation and damping if enabled. The saturation
+    // is late by a fixed number of samples, so the result belongs that far
+    // back.
+    float feedbackSample = inputSample + delayedSample * feedback;
+    float written = feedbackSample;
+    if(saturationEnabled)
+        written = saturator.processSample(written);
+    if(dampingEnabled)
+        written = dampingHighpass.processSample(dampingLowpass.processSample(written));
+    delayBuffer[(writePointer + size - writeLag()) % size] = written;
+    if(vabs(feedbackSample) > 1e-5f)
+        silentRun = 0;
+    else if(silentRun < size)
+        silentRun++;
+    writePointer = (writePointer + 1) % size;
+
+    return output;
+}
+
+#endif
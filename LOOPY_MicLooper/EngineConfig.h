@@ -0,0 +1,76 @@
+#ifndef ENGINE_CONFIG_H
+#define ENGINE_CONFIG_H
+
+// What a deployment fixes about the engine: sample rate, block size,
+// channels, buffer sizes, how stored loops are kept and where the controls
+// are wired.
+//
+// A profile is a constexpr EngineConfig, chosen at build time with
+// -DENGINE_PROFILE=<name> (the default is gEngineBela, as settings.json
+// runs it). Code that takes the config as a template parameter by
+// reference (template <const EngineConfig& Config>) and is instantiated
+// for the profile sees every field as a constant, so block and channel
+// loops get fixed trip counts, ring wraps become multiplies and
+// sample-rate arithmetic folds. The same code instantiated for a
+// non-constant EngineConfig is the runtime-configured fallback: render.cpp
+// takes it when Bela runs with another -p, sample rate or channel count
+// than the profile was built for.
+//
+// Buffer sizes, storage and wiring come from the profile on both paths.
+
+#include "LoopStorage.h"
+
+struct EngineConfig {
+    unsigned int sampleRate;
+    unsigned int blockSize;         // frames per render() call (-p)
+    unsigned int channels;          // audio outputs written
+    unsigned int maxLoopSamples;    // longest first take
+    unsigned int maxMultiple;       // a loop can be multiplied up to this length
+    unsigned int poolSamples;       // of which this much can be recorded over
+    unsigned int delaySamples;      // DelayEffect line length
+    LoopStorage storage;            // stored loop banks
+    unsigned int recordPin;         // record/play button
+    unsigned int clearPin;          // clear buffer button
+    unsigned int ledPin;            // LED indicator
+    unsigned int mixChannel;        // analog inputs: delay mix,
+    unsigned int feedbackChannel;   //   delay feedback,
+    unsigned int lfoDepthChannel;   //   LFO depth (modulates the delay time),
+    unsigned int speedChannel;      //   playback speed
+};
+
+// True if a context of this rate, block size and output channel count
+// runs at the profile's constants
+inline bool engineConfigMatches(const EngineConfig& config, float sampleRate, unsigned int blockSize, unsigned int channels)
+{
+    return config.sampleRate == sampleRate && config.blockSize == blockSize && config.channels == channels;
+}
+
+// ------------------------------------------------------
+// Profiles
+
+// Bela at 44.1kHz, -p 8, stereo out; a 20s first take, multipliable 4x
+// with 40s of recorded material, and a 1s delay line
+constexpr EngineConfig gEngineBela = {
+    44100, 8, 2,
+    44100 * 20, 4, 44100 * 40, 44100,
+    LOOP_STORE_LOSSLESS,
+    7, 10, 6,
+    0, 1, 2, 3
+};
+
+// The same at -p 32, for a board loaded with other work; stored loops are
+// kept raw, which takes 4/3 or more of the memory but switches banks with
+// no decoding
+constexpr EngineConfig gEngineBelaRelaxed = {
+    44100, 32, 2,
+    44100 * 20, 4, 44100 * 40, 44100,
+    LOOP_STORE_RAW,
+    7, 10, 6,
+    0, 1, 2, 3
+};
+
+#ifndef ENGINE_PROFILE
+#define ENGINE_PROFILE gEngineBela
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#include "EnvelopeFollower.h"
+#include "FastMath.h"
+#include <cmath>
+
+EnvelopeFollower::EnvelopeFollower(float sr)
+    : sampleRate(sr)
+    , attackMs(5.0f)
+    , releaseMs(150.0f)
+    , detector(PEAK)
+    , blockSize(0)
+    , attackCoeff(0.f)
+    , releaseCoeff(0.f)
+    , current(0.f)
+{
+}
+
+void EnvelopeFollower::setAttack(float ms)
+{
+    attackMs = ms;
+    blockSize = 0; // recompute on the next block
+}
+
+void EnvelopeFollower::setRelease(float ms)
+{
+    releaseMs = ms;
+    blockSize = 0;
+}
+
+// One block of n samples is n/fs seconds, so the per-block pole of a
+// time constant tau is exp(-n / (tau * fs))
+void EnvelopeFollower::updateCoefficients(unsigned int n)
+{
+    float blockSec = (float)n / sampleRate;
+    attackCoeff = fast_exp(-blockSec / (0.001f * attackMs));
+    releaseCoeff = fast_exp(-blockSec / (0.001f * releaseMs));
+    blockSize = n;
+}
+
+void EnvelopeFollower::processBlock(const float* buf, unsigned int n)
+{
+    if(n == 0)
+        return;
+    if(n != blockSize)
+        updateCoefficients(n);
+
+    float level;
+    unsigned int i = 0;
+    if(detector == PEAK) {
+        vf4 peak(0.f);
+        for(; i + 4 <= n; i += 4)
+            peak = vmax(peak, vabs(vf4::load(buf + i)));
+        level = hmax(peak);
+        for(; i < n; i++)
+            level = vmax(level, vabs(buf[i]));
+    } else {
+        vf4 sum(0.f);
+        for(; i + 4 <= n; i += 4) {
+            vf4 x = vf4::load(buf + i);
+            sum = sum + x * x;
+        }
+        level = hsum(sum);
+        for(; i < n; i++)
+            level += buf[i] * buf[i];
+        level = sqrtf(level / (float)n);
+    }
+
+    float coeff = level > current ? attackCoeff : releaseCoeff;
+    current = level + coeff * (current - level);
+}
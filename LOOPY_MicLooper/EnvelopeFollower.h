@@ -0,0 +1,38 @@
+#ifndef ENVELOPE_FOLLOWER_H
+#define ENVELOPE_FOLLOWER_H
+
+// Envelope follower that runs once per block: the block's peak or RMS is
+// measured with SIMD and fed to a one-pole attack/release smoother whose
+// coefficients are scaled to the block length. Read value() once per
+// block; routed through the ModMatrix, destinations ramp to it across the
+// block.
+class EnvelopeFollower {
+public:
+    enum Detector { PEAK, RMS };
+
+    EnvelopeFollower(float sampleRate);
+
+    void setAttack(float ms);
+    void setRelease(float ms);
+    void setDetector(Detector d) { detector = d; }
+
+    void processBlock(const float* buf, unsigned int n);
+
+    float value() const { return current; }
+
+private:
+    void updateCoefficients(unsigned int n);
+
+    float sampleRate;
+    float attackMs;
+    float releaseMs;
+    Detector detector;
+
+    unsigned int blockSize;   // length the coefficients were computed for
+    float attackCoeff;
+    float releaseCoeff;
+
+    float current;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+// Fast replacements for the libm functions used on the audio path. Every
+// function is a template over float, vf4 and (on AVX2 hosts) vf8, so the
+// scalar and vector versions are the same code. Polynomials are the Cephes
+// single-precision ones; argument reduction avoids all libm calls.
+//
+// Max error against correctly rounded results, measured by bench/bench.cpp
+// over the stated domain (finite inputs only, no NaN/Inf handling):
+//   fast_floor   exact          |x| < 2^31
+//   fast_exp2    2 ulp          [-126, 126], clamped outside
+//   fast_exp     2 ulp          [-87, 87], clamped outside
+//   fast_log2    2 ulp          positive normal floats
+//   fast_sin     2 ulp          |x| < 8192
+//   fast_cos     2 ulp          |x| < 8192
+//   fast_tanh    3 ulp          all finite x
+// On NEON the divides inside fast_tanh go through vrecip(), which adds
+// up to 1 ulp there.
+
+#include "Simd.h"
+
+#define FM_LOG2E     1.44269504088896341f
+#define FM_4_OVER_PI 1.27323954473516268f
+
+template <typename V>
+SIMD_INLINE V fast_floor(V x)
+{
+    return vfloor(x);
+}
+
+template <typename V>
+SIMD_INLINE V fast_exp2(V x)
+{
+    x = vmin(vmax(x, V(-126.f)), V(126.f));
+    V n = vfloor(x + V(0.5f));
+    V f = x - n; // [-0.5, 0.5]
+
+    V p = V(1.535336188319500e-4f);
+    p = p * f + V(1.339887440266574e-3f);
+    p = p * f + V(9.618437357674640e-3f);
+    p = p * f + V(5.550332471162809e-2f);
+    p = p * f + V(2.402264791363012e-1f);
+    p = p * f + V(6.931472028550421e-1f);
+    p = p * f + V(1.f);
+    return p * vpow2i(n);
+}
+
+template <typename V>
+SIMD_INLINE V fast_exp(V x)
+{
+    x = vmin(vmax(x, V(-87.f)), V(87.f));
+    V n = vfloor(x * V(FM_LOG2E) + V(0.5f));
+    // Cody-Waite: subtract n*ln2 in two parts to keep the reduction exact
+    V r = x - n * V(0.693359375f);
+    r = r + n * V(2.12194440e-4f);
+
+    V z = r * r;
+    V p = V(1.9875691500e-4f);
+    p = p * r + V(1.3981999507e-3f);
+    p = p * r + V(8.3334519073e-3f);
+    p = p * r + V(4.1665795894e-2f);
+    p = p * r + V(1.6666665459e-1f);
+    p = p * r + V(5.0000001201e-1f);
+    p = p * z + r + V(1.f);
+    return p * vpow2i(n);
+}
+
+template <typename V>
+SIMD_INLINE V fast_log2(V x)
+{
+    V e = vexponent(x);
+    V m = vmantissa(x); // [0.5, 1)
+
+    // move the mantissa to [sqrt(0.5), sqrt(2)) - 1
+    V small = m < V(0.707106781186547524f);
+    e = e - vselect(small, V(1.f), V(0.f));
+    m = m + vselect(small, m, V(0.f)) - V(1.f);
+
+    V z = m * m;
+    V p = V(7.0376836292e-2f);
+    p = p * m - V(1.1514610310e-1f);
+    p = p * m + V(1.1676998740e-1f);
+    p = p * m - V(1.2420140846e-1f);
+    p = p * m + V(1.4249322787e-1f);
+    p = p * m - V(1.6668057665e-1f);
+    p = p * m + V(2.0000714765e-1f);
+    p = p * m - V(2.4999993993e-1f);
+    p = p * m + V(3.3333331174e-1f);
+    V y = p * m * z - V(0.5f) * z;
+
+    return (m + y) * V(FM_LOG2E) + e;
+}
+
+// Reduce x to r in [-pi/4, pi/4] with x = k*pi/2 + r; returns k mod 4
+template <typename V>
+SIMD_INLINE V fast_trig_reduce(V x, V& r)
+{
+    V y = vfloor(x * V(FM_4_OVER_PI));
+    y = y + (y - V(2.f) * vfloor(y * V(0.5f))); // round odd octants up
+    r = x - y * V(0.78515625f);
+    r = r - y * V(2.4187564849853515625e-4f);
+    r = r - y * V(3.77489497744594108e-8f);
+    V q = y * V(0.5f);
+    return q - V(4.f) * vfloor(q * V(0.25f));
+}
+
+template <typename V>
+SIMD_INLINE V fast_sin_poly(V r, V z)
+{
+    V p = V(-1.9515295891e-4f);
+    p = p * z + V(8.3321608736e-3f);
+    p = p * z - V(1.6666654611e-1f);
+    return p * z * r + r;
+}
+
+template <typename V>
+SIMD_INLINE V fast_cos_poly(V z)
+{
+    V p = V(2.443315711809948e-5f);
+    p = p * z - V(1.388731625493765e-3f);
+    p = p * z + V(4.166664568298827e-2f);
+    return p * z * z - V(0.5f) * z + V(1.f);
+}
+
+template <typename V>
+SIMD_INLINE V fast_sin(V x)
+{
+    V negative = x < V(0.f);
+    V r;
+    V k = fast_trig_reduce(vabs(x), r);
+    V z = r * r;
+
+    V odd = (k - V(2.f) * vfloor(k * V(0.5f))) > V(0.5f);
+    V y = vselect(odd, fast_cos_poly(z), fast_sin_poly(r, z));
+    V flip = (k > V(1.5f));
+    y = vselect(flip, -y, y);
+    return vselect(negative, -y, y);
+}
+
+template <typename V>
+SIMD_INLINE V fast_cos(V x)
+{
+    V r;
+    V k = fast_trig_reduce(vabs(x), r);
+    V z = r * r;
+
+    V odd = (k - V(2.f) * vfloor(k * V(0.5f))) > V(0.5f);
+    V y = vselect(odd, fast_sin_poly(r, z), fast_cos_poly(z));
+    V flip = (k > V(0.5f)) & (k < V(2.5f));
+    return vselect(flip, -y, y);
+}
+
+template <typename V>
+SIMD_INLINE V fast_tanh(V x)
+{
+    V a = vabs(x);
+
+    // small |x|: odd polynomial
+    V z = x * x;
+    V p = V(-5.70498872745e-3f);
+    p = p * z + V(2.06390887954e-2f);
+    p = p * z - V(5.37397155531e-2f);
+    p = p * z + V(1.33314422036e-1f);
+    p = p * z - V(3.33332819422e-1f);
+    V small = p * z * x + x;
+
+    // large |x|: 1 - 2 / (e^2|x| + 1), sign restored
+    V e = fast_exp(vmin(a + a, V(20.f)));
+    V large = V(1.f) - V(2.f) * vrecip(e + V(1.f));
+    large = vselect(x < V(0.f), -large, large);
+
+    return vselect(a < V(0.625f), small, large);
+}
+
+// ------------------------------------------------------
+// Block helpers: widest vector type first, scalar code for the tail
+
+template <typename F>
+inline void fast_map(float* out, const float* in, unsigned int n, F fn)
+{
+    unsigned int i = 0;
+#if LOOPY_SIMD_AVX2
+    for(; i + 8 <= n; i += 8)
+        fn(vf8::load(in + i)).store(out + i);
+#endif
+    for(; i + 4 <= n; i += 4)
+        fn(vf4::load(in + i)).store(out + i);
+    for(; i < n; i++)
+        out[i] = fn(in[i]);
+}
+
+inline void fast_exp2_block(float* out, const float* in, unsigned int n)
+{
+    fast_map(out, in, n, [](auto v) { return fast_exp2(v); });
+}
+
+inline void fast_sin_block(float* out, const float* in, unsigned int n)
+{
+    fast_map(out, in, n, [](auto v) { return fast_sin(v); });
+}
+
+inline void fast_tanh_block(float* out, const float* in, unsigned int n)
+{
+    fast_map(out, in, n, [](auto v) { return fast_tanh(v); });
+}
+
+#endif //FAST_MATH_H
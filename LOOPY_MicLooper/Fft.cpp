@@ -0,0 +1,108 @@
+#include "Fft.h"
+#include <cmath>
+#include <utility>
+
+Fft::Fft()
+    : n(0)
+{
+}
+
+void Fft::resize(unsigned int size)
+{
+    n = size;
+    unsigned int half = n / 2;
+    twiddles.resize(half);
+    for(unsigned int k = 0; k < half; k++) {
+        double phase = -2.0 * M_PI * k / n;
+        twiddles[k].re = (float)std::cos(phase);
+        twiddles[k].im = (float)std::sin(phase);
+    }
+    unsigned int bits = 0;
+    while((1u << bits) < half)
+        bits++;
+    reversed.resize(half);
+    for(unsigned int i = 0; i < half; i++) {
+        unsigned int r = 0;
+        for(unsigned int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1u) << (bits - 1 - b);
+        reversed[i] = r;
+    }
+    work.resize(half);
+}
+
+// In-place complex FFT of n/2 points. The twiddles for n/2 points are
+// every other one of the n-point table.
+void Fft::transform(Complex* data, bool inverse) const
+{
+    unsigned int m = n / 2;
+    for(unsigned int i = 0; i < m; i++)
+        if(i < reversed[i])
+            std::swap(data[i], data[reversed[i]]);
+
+    for(unsigned int span = 1; span < m; span <<= 1) {
+        unsigned int stride = n / (2 * span);
+        for(unsigned int start = 0; start < m; start += 2 * span) {
+            for(unsigned int k = 0; k < span; k++) {
+                Complex w = twiddles[k * stride];
+                if(inverse)
+                    w.im = -w.im;
+                Complex& a = data[start + k];
+                Complex& b = data[start + k + span];
+                float re = b.re * w.re - b.im * w.im;
+                float im = b.re * w.im + b.im * w.re;
+                b.re = a.re - re;
+                b.im = a.im - im;
+                a.re += re;
+                a.im += im;
+            }
+        }
+    }
+}
+
+void Fft::forward(const float* in, Complex* out)
+{
+    unsigned int m = n / 2;
+    for(unsigned int i = 0; i < m; i++) {
+        work[i].re = in[2 * i];
+        work[i].im = in[2 * i + 1];
+    }
+    transform(work.data(), false);
+
+    // X[k] = E[k] + W^k O[k], with E and O the spectra of the even and odd
+    // samples: E = (Z[k] + Z*[m-k]) / 2, O = (Z[k] - Z*[m-k]) / 2i
+    out[0].re = work[0].re + work[0].im;
+    out[0].im = 0.f;
+    out[m].re = work[0].re - work[0].im;
+    out[m].im = 0.f;
+    for(unsigned int k = 1; k < m; k++) {
+        const Complex& z = work[k];
+        const Complex& c = work[m - k];
+        float er = 0.5f * (z.re + c.re), ei = 0.5f * (z.im - c.im);
+        float or_ = 0.5f * (z.im + c.im), oi = -0.5f * (z.re - c.re);
+        const Complex& w = twiddles[k];
+        out[k].re = er + w.re * or_ - w.im * oi;
+        out[k].im = ei + w.re * oi + w.im * or_;
+    }
+}
+
+void Fft::inverse(const Complex* in, float* out)
+{
+    unsigned int m = n / 2;
+    // E = (X[k] + X*[m-k]) / 2, O = (X[k] - X*[m-k]) W^-k / 2; Z = E + iO
+    for(unsigned int k = 0; k < m; k++) {
+        const Complex& x = in[k];
+        const Complex& c = in[m - k];
+        float er = 0.5f * (x.re + c.re), ei = 0.5f * (x.im - c.im);
+        float dr = 0.5f * (x.re - c.re), di = 0.5f * (x.im + c.im);
+        const Complex& w = twiddles[k];
+        float or_ = dr * w.re + di * w.im;
+        float oi = di * w.re - dr * w.im;
+        work[k].re = er - oi;
+        work[k].im = ei + or_;
+    }
+    transform(work.data(), true);
+    for(unsigned int i = 0; i < m; i++) {
+        out[2 * i] = 2.f * work[i].re;
+        out[2 * i + 1] = 2.f * work[i].im;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef FFT_H
+#define FFT_H
+
+// Real FFT of power-of-two size, for analysis off the audio thread
+// (spectrum display, loop-point search).
+//
+// A real frame of n samples is transformed as a complex one of n/2 points
+// (even samples real, odd imaginary) and split into the n/2+1 bins of the
+// real spectrum afterwards, so it costs about half a complex FFT of the
+// same size. The complex core is iterative radix-2 with twiddles and the
+// bit-reversal permutation computed by resize(). Unnormalised: inverse()
+// of forward() returns the input times n.
+
+#include <vector>
+
+struct Complex {
+    float re;
+    float im;
+};
+
+class Fft {
+public:
+    Fft();
+
+    // Allocates; not real-time safe. n is a power of two, at least 4.
+    void resize(unsigned int n);
+    unsigned int size() const { return n; }
+    unsigned int numBins() const { return n / 2 + 1; }
+
+    // n real samples -> n/2+1 bins
+    void forward(const float* in, Complex* out);
+    // n/2+1 bins -> n real samples
+    void inverse(const Complex* in, float* out);
+
+private:
+    void transform(Complex* data, bool inverse) const;
+
+    unsigned int n;
+    std::vector<Complex> twiddles;     // e^(-2 pi i k / n), k < n/2
+    std::vector<unsigned int> reversed;
+    std::vector<Complex> work;
+};
+
+#endif
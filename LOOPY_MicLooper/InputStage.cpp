@@ -0,0 +1,118 @@
+#include "InputStage.h"
+#include "FastMath.h"
+#include <cmath>
+#include <cstring>
+
+InputStage::InputStage(float sr)
+    : sampleRate(sr)
+    , r(0.f)
+    , lastIn(0.f)
+    , lastOut(0.f)
+    , openThreshold(0.f)
+    , closeThreshold(0.f)
+    , holdSamples(0)
+    , holdCounter(0)
+    , open(false)
+    , gain(0.f)
+    , peak(0.f)
+{
+    setDcCutoff(20.0f);
+    setGate(-50.0f, -56.0f, 100.0f);
+}
+
+void InputStage::setDcCutoff(float hz)
+{
+    r = fast_exp(-2.0f * (float)M_PI * hz / sampleRate);
+
+    float power[5] = { 1.f, r, r * r, r * r * r, r * r * r * r };
+    for(unsigned int j = 0; j < 4; j++)
+        for(unsigned int k = 0; k < 4; k++)
+            dcColumns[j][k] = 0.f;
+    for(unsigned int j = 0; j < 4; j++)
+        for(unsigned int k = j; k < 4; k++)
+            dcColumns[j][k] = power[k - j];
+    for(unsigned int k = 0; k < 4; k++)
+        dcFeedback[k] = power[k + 1];
+}
+
+void InputStage::setGate(float openDb, float closeDb, float holdMs)
+{
+    if(closeDb > openDb)
+        closeDb = openDb;
+    // 10^(dB/20) = 2^(dB * log2(10) / 20)
+    openThreshold = fast_exp2(openDb * 0.166096404f);
+    closeThreshold = fast_exp2(closeDb * 0.166096404f);
+    holdSamples = (unsigned int)(holdMs * 0.001f * sampleRate);
+}
+
+bool InputStage::processBlock(float* buf, unsigned int n)
+{
+    // (1) DC blocker. The differences are independent, so they are formed
+    // first; the recursion is then unrolled four samples per vector step.
+    unsigned int i = 0;
+    float prevIn = lastIn;
+    for(; i + 4 <= n; i += 4) {
+        float d[4] = { buf[i] - prevIn, buf[i + 1] - buf[i], buf[i + 2] - buf[i + 1], buf[i + 3] - buf[i + 2] };
+        prevIn = buf[i + 3];
+
+        vf4 y = vf4(lastOut) * vf4::load(dcFeedback);
+        y = y + vf4(d[0]) * vf4::load(dcColumns[0]);
+        y = y + vf4(d[1]) * vf4::load(dcColumns[1]);
+        y = y + vf4(d[2]) * vf4::load(dcColumns[2]);
+        y = y + vf4(d[3]) * vf4::load(dcColumns[3]);
+        y.store(buf + i);
+        lastOut = vlane(y, 3);
+    }
+    for(; i < n; i++) {
+        float x = buf[i];
+        lastOut = x - prevIn + r * lastOut;
+        prevIn = x;
+        buf[i] = lastOut;
+    }
+    lastIn = prevIn;
+
+    // (2) Block peak for the gate detector
+    vf4 vpeak(0.f);
+    for(i = 0; i + 4 <= n; i += 4)
+        vpeak = vmax(vpeak, vabs(vf4::load(buf + i)));
+    float p = hmax(vpeak);
+    for(; i < n; i++)
+        p = vmax(p, vabs(buf[i]));
+    peak = p;
+
+    // (3) Gate with hysteresis and hold
+    if(p >= openThreshold) {
+        open = true;
+        holdCounter = holdSamples;
+    } else if(open) {
+        if(holdCounter > n)
+            holdCounter -= n;
+        else
+            holdCounter = 0;
+        if(holdCounter == 0 && p < closeThreshold)
+            open = false;
+    }
+
+    float target = open ? 1.f : 0.f;
+    if(gain == target) {
+        if(gain == 0.f) {
+            std::memset(buf, 0, n * sizeof(float));
+            return false;
+        }
+        return true;
+    }
+
+    // ramp the gain across this block to avoid clicks
+    static const float ramp[4] = { 1.f, 2.f, 3.f, 4.f };
+    float step = (target - gain) / (float)n;
+    vf4 g = vf4(gain) + vf4(step) * vf4::load(ramp);
+    vf4 g4(4.f * step);
+    for(i = 0; i + 4 <= n; i += 4) {
+        (vf4::load(buf + i) * g).store(buf + i);
+        g = g + g4;
+    }
+    for(; i < n; i++)
+        buf[i] *= gain + step * (float)(i + 1);
+    gain = target;
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef INPUT_STAGE_H
+#define INPUT_STAGE_H
+
+// Block-based conditioning for the microphone input: a DC blocker
+// (first-order high-pass) followed by a noise gate with hysteresis and
+// hold. processBlock() reports whether the block carries any signal, so
+// later stages can take a cheap path while the gate is shut.
+class InputStage {
+public:
+    InputStage(float sampleRate);
+
+    void setDcCutoff(float hz);
+    // open/close thresholds in dBFS (close below open), hold time in ms
+    void setGate(float openDb, float closeDb, float holdMs);
+
+    // Condition n samples in place. Returns false when the whole block
+    // was gated to silence (all zeros).
+    bool processBlock(float* buf, unsigned int n);
+
+    bool isOpen() const { return open; }
+    float lastPeak() const { return peak; }
+
+private:
+    float sampleRate;
+
+    // DC blocker: y[n] = x[n] - x[n-1] + r*y[n-1], solved four samples at a time
+    float r;
+    float dcColumns[4][4];  // contribution of d[i+j] to y[i+k]
+    float dcFeedback[4];    // r^(k+1): contribution of y[i-1] to y[i+k]
+    float lastIn;
+    float lastOut;
+
+    // gate
+    float openThreshold;
+    float closeThreshold;
+    unsigned int holdSamples;
+    unsigned int holdCounter;
+    bool open;
+    float gain;             // 0..1, ramped over one block on open/close
+    float peak;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+// Fractional-position readers for delay lines, the varispeed loop reader
+// and resampling, from cheapest to best. Each reads the signal at
+// x[0 + frac], frac in [0, 1), from the samples around x, which must all
+// be valid: up to INTERP_BEFORE samples before x and INTERP_AFTER after.
+//
+// bench/bench.cpp interp measures each one's distortion, aliasing, error
+// against an ideal fractional delay, modulation sidebands and cost against
+// speed and modulation depth, and which is the cheapest for a given
+// quality bar. None of them band-limits: read faster than 1x, a tone
+// above 22050 / speed folds back almost at full level.
+
+#include "Tables.h"
+
+#define INTERP_BEFORE  (SINC_TAPS / 2 - 1)
+#define INTERP_AFTER   (SINC_TAPS / 2)
+
+// The sample at or before the position, as the loop reader has it
+inline float interp_truncate(const float* x, float frac)
+{
+    (void)frac;
+    return x[0];
+}
+
+// Two points, as DelayEffect has it
+inline float interp_linear(const float* x, float frac)
+{
+    return x[0] + frac * (x[1] - x[0]);
+}
+
+// Four-point, third-order Hermite (Catmull-Rom): continuous slope, so
+// smoother than linear under modulation
+inline float interp_hermite(const float* x, float frac)
+{
+    float c1 = 0.5f * (x[1] - x[-1]);
+    float c2 = x[-1] - 2.5f * x[0] + 2.f * x[1] - 0.5f * x[2];
+    float c3 = 0.5f * (x[2] - x[-1]) + 1.5f * (x[0] - x[1]);
+    return ((c3 * frac + c2) * frac + c1) * frac + x[0];
+}
+
+// Four-point, third-order Lagrange: exact on cubics, so nearer the ideal
+// fractional delay than Hermite at low frequencies. At frac 0.5 the two
+// have the same taps, and towards the top of the band the same error.
+inline float interp_lagrange(const float* x, float frac)
+{
+    float d0 = frac + 1.f, d1 = frac, d2 = frac - 1.f, d3 = frac - 2.f;
+    return -x[-1] * (d1 * d2 * d3) * (1.f / 6.f)
+           + x[0] * (d0 * d2 * d3) * 0.5f
+           - x[1] * (d0 * d1 * d3) * 0.5f
+           + x[2] * (d0 * d1 * d2) * (1.f / 6.f);
+}
+
+// SINC_TAPS-point windowed sinc from gSincTable, its taps interpolated
+// between the two nearest of its SINC_PHASES phases
+inline float interp_sinc(const float* x, float frac)
+{
+    float pos = frac * SINC_PHASES;
+    unsigned int p = (unsigned int)pos;
+    float t = pos - (float)p;
+    const float* a = gSincTable.v[p];
+    const float* b = gSincTable.v[p + 1];
+    const float* s = x - INTERP_BEFORE;
+    float sum = 0.f;
+    for(unsigned int j = 0; j < SINC_TAPS; j++)
+        sum += s[j] * (a[j] + t * (b[j] - a[j]));
+    return sum;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "JobScheduler.h"
+#include <chrono>
+#include <thread>
+
+static double nowUs()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Job::Job()
+    : next(nullptr),
+      priority(JOB_NORMAL),
+      queued(false)
+{
+}
+
+JobScheduler::JobScheduler()
+    : wakeup(nullptr),
+      wakeupArg(nullptr),
+      awake(false),
+      numCompleted(0),
+      numSteps(0),
+      longest(0.f)
+{
+    for(unsigned int p = 0; p < JOB_PRIORITIES; p++) {
+        inbox[p].store(nullptr);
+        head[p] = tail[p] = nullptr;
+    }
+}
+
+void JobScheduler::setWakeup(void (*wake)(void*), void* arg)
+{
+    wakeup = wake;
+    wakeupArg = arg;
+}
+
+bool JobScheduler::enqueue(Job& job, JobPriority priority)
+{
+    bool idle = false;
+    if(!job.queued.compare_exchange_strong(idle, true, std::memory_order_acq_rel))
+        return false;
+    job.priority = priority;
+
+    Job* first = inbox[priority].load(std::memory_order_relaxed);
+    do {
+        job.next = first;
+    } while(!inbox[priority].compare_exchange_weak(first, &job, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+    // only the first enqueue after the runner went idle wakes it
+    if(!awake.exchange(true) && wakeup)
+        wakeup(wakeupArg);
+    return true;
+}
+
+// Move everything enqueued since the last call onto the run queues, in
+// the order it arrived
+void JobScheduler::collect()
+{
+    for(unsigned int p = 0; p < JOB_PRIORITIES; p++) {
+        Job* list = inbox[p].exchange(nullptr, std::memory_order_acquire);
+        Job* reversed = nullptr;
+        while(list) {
+            Job* next = list->next;
+            list->next = reversed;
+            reversed = list;
+            list = next;
+        }
+        if(!reversed)
+            continue;
+        if(tail[p])
+            tail[p]->next = reversed;
+        else
+            head[p] = reversed;
+        Job* last = reversed;
+        while(last->next)
+            last = last->next;
+        tail[p] = last;
+    }
+}
+
+Job* JobScheduler::pick()
+{
+    for(unsigned int p = 0; p < JOB_PRIORITIES; p++) {
+        Job* job = head[p];
+        if(!job)
+            continue;
+        head[p] = job->next;
+        if(!head[p])
+            tail[p] = nullptr;
+        job->next = nullptr;
+        return job;
+    }
+    return nullptr;
+}
+
+bool JobScheduler::runSlice(unsigned int sliceUs)
+{
+    double start = nowUs();
+    for(;;) {
+        collect();
+        Job* job = pick();
+        if(!job)
+            return false;
+
+        double t0 = nowUs();
+        bool done = job->step();
+        double t1 = nowUs();
+        numSteps.fetch_add(1, std::memory_order_relaxed);
+        if(t1 - t0 > longest.load(std::memory_order_relaxed))
+            longest.store((float)(t1 - t0), std::memory_order_relaxed);
+
+        if(done) {
+            numCompleted.fetch_add(1, std::memory_order_relaxed);
+            job->queued.store(false, std::memory_order_release);
+        } else {
+            // back of its priority: round-robin with its peers
+            unsigned int p = job->priority;
+            if(tail[p])
+                tail[p]->next = job;
+            else
+                head[p] = job;
+            tail[p] = job;
+        }
+        if(t1 - start >= sliceUs)
+            return true;
+    }
+}
+
+void JobScheduler::runUntilIdle(unsigned int sliceUs, unsigned int restUs)
+{
+    for(;;) {
+        while(runSlice(sliceUs))
+            std::this_thread::sleep_for(std::chrono::microseconds(restUs));
+
+        // An enqueue that raced with going idle saw `awake` still set and
+        // did not wake anyone: look again after clearing it
+        awake.store(false);
+        bool pending = false;
+        for(unsigned int p = 0; p < JOB_PRIORITIES; p++)
+            pending = pending || inbox[p].load() != nullptr;
+        if(!pending || awake.exchange(true))
+            return;
+    }
+}
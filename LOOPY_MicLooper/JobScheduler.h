@@ -0,0 +1,93 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+// Time-sliced background work: saving and restoring loop banks, analysis,
+// anything too slow for render(). A job is an object whose step() does one
+// chunk of the work and says whether there is more; the scheduler resumes
+// it where it left off, so long jobs interleave instead of running to
+// completion one after the other.
+//
+// Jobs run highest priority first and round-robin within a priority, one
+// step at a time: a step is the unit of preemption, so keep steps short
+// (a millisecond or so). The runner works in slices and rests between
+// them, so a backlog of jobs never takes the CPU in one long burst.
+//
+// enqueue() is lock-free and allocation-free, safe from render(): jobs are
+// preallocated by their owner and linked into a per-priority inbox with a
+// compare-and-swap. There is one runner, typically a Bela auxiliary task
+// (or a host thread) that the wake-up callback schedules when work
+// arrives. C++14 has no coroutines, so a job keeps its own progress in
+// members between steps.
+
+#include <atomic>
+
+#define JOB_PRIORITIES  3
+
+enum JobPriority {
+    JOB_HIGH = 0,       // someone is waiting for it
+    JOB_NORMAL,
+    JOB_LOW             // housekeeping
+};
+
+class Job {
+public:
+    Job();
+    virtual ~Job() {}
+
+    // Do the next chunk of work; return true when the job is finished
+    virtual bool step() = 0;
+
+    // True from enqueue() until the last step returns
+    bool busy() const { return queued.load(std::memory_order_acquire); }
+
+private:
+    friend class JobScheduler;
+    Job* next;
+    JobPriority priority;
+    std::atomic<bool> queued;
+};
+
+class JobScheduler {
+public:
+    JobScheduler();
+
+    // Called (from the enqueuing thread) when the runner should start;
+    // must be real-time safe if render() enqueues, e.g. a function that
+    // calls Bela_scheduleAuxiliaryTask()
+    void setWakeup(void (*wake)(void*), void* arg);
+
+    // ---- any thread, lock-free
+    // Returns false if the job is already queued or running
+    bool enqueue(Job& job, JobPriority priority);
+
+    // ---- the runner
+    // Run steps for about `sliceUs` microseconds. Returns true if work is
+    // left.
+    bool runSlice(unsigned int sliceUs);
+    // Run slices until nothing is queued, resting `restUs` between them
+    void runUntilIdle(unsigned int sliceUs, unsigned int restUs);
+
+    // ---- statistics, any thread
+    unsigned int completed() const { return numCompleted.load(std::memory_order_relaxed); }
+    unsigned int steps() const { return numSteps.load(std::memory_order_relaxed); }
+    // Longest single step so far, in microseconds
+    float longestStep() const { return longest.load(std::memory_order_relaxed); }
+
+private:
+    void collect();
+    Job* pick();
+
+    void (*wakeup)(void*);
+    void* wakeupArg;
+    std::atomic<bool> awake;            // the runner is scheduled or running
+
+    std::atomic<Job*> inbox[JOB_PRIORITIES];    // pushed LIFO by enqueue()
+    Job* head[JOB_PRIORITIES];                  // runner's FIFO per priority
+    Job* tail[JOB_PRIORITIES];
+
+    std::atomic<unsigned int> numCompleted;
+    std::atomic<unsigned int> numSteps;
+    std::atomic<float> longest;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "LatencyCalibrator.h"
+#include "Simd.h"
+#include <cmath>
+
+// A detected peak must stand this far above the correlation's RMS
+#define LATENCY_MIN_CONFIDENCE 8.0f
+
+LatencyCalibrator::LatencyCalibrator()
+    : maxLatency(0)
+    , position(0)
+    , level(0.25f)
+    , currentState(IDLE)
+    , result(0)
+    , peakRatio(0.f)
+{
+}
+
+void LatencyCalibrator::setup(unsigned int maxLat, float lvl)
+{
+    if(maxLat >= LATENCY_MLS_PERIOD)
+        maxLat = LATENCY_MLS_PERIOD - 1;
+    maxLatency = maxLat;
+    level = lvl;
+
+    // Galois LFSR for x^12 + x^11 + x^10 + x^4 + 1, a primitive polynomial
+    sequence.assign((LATENCY_MLS_PERIOD + 3) & ~3u, 0.f);
+    unsigned int lfsr = 1;
+    for(unsigned int i = 0; i < LATENCY_MLS_PERIOD; i++) {
+        sequence[i] = (lfsr & 1) ? 1.f : -1.f;
+        lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? 0xe08u : 0u);
+    }
+    recording.assign(2 * LATENCY_MLS_PERIOD + maxLatency + 4, 0.f);
+    currentState.store(IDLE, std::memory_order_relaxed);
+}
+
+void LatencyCalibrator::start()
+{
+    if(recording.empty())
+        return;
+    position = 0;
+    currentState.store(MEASURING, std::memory_order_relaxed);
+}
+
+bool LatencyCalibrator::processBlock(const float* in, float* out, unsigned int n)
+{
+    if(currentState.load(std::memory_order_relaxed) != MEASURING)
+        return false;
+
+    unsigned int length = 2 * LATENCY_MLS_PERIOD + maxLatency;
+    for(unsigned int i = 0; i < n; i++) {
+        if(position < length) {
+            recording[position] = in[i];
+            out[i] = level * sequence[position % LATENCY_MLS_PERIOD];
+            position++;
+        } else {
+            out[i] = 0.f;
+        }
+    }
+    if(position >= length)
+        currentState.store(CAPTURED, std::memory_order_release);
+    return true;
+}
+
+void LatencyCalibrator::analyse()
+{
+    if(state() != CAPTURED)
+        return;
+
+    // c[lag] = sum over one period of mls[i] * in[P + i + lag]; the padding
+    // of the sequence is zero, so the dot products can run in whole vf4s
+    const float* in = recording.data() + LATENCY_MLS_PERIOD;
+    unsigned int taps = (unsigned int)sequence.size();
+    float best = 0.f, sumSquares = 0.f;
+    unsigned int bestLag = 0;
+    for(unsigned int lag = 0; lag <= maxLatency; lag++) {
+        vf4 acc(0.f);
+        for(unsigned int i = 0; i < taps; i += 4)
+            acc = acc + vf4::load(&sequence[i]) * vf4::load(in + lag + i);
+        float c = hsum(acc);
+        sumSquares += c * c;
+        if(std::fabs(c) > std::fabs(best)) {
+            best = c;
+            bestLag = lag;
+        }
+    }
+
+    float rms = std::sqrt(sumSquares / (float)(maxLatency + 1));
+    peakRatio = rms > 0.f ? std::fabs(best) / rms : 0.f;
+    result = bestLag;
+    currentState.store(peakRatio >= LATENCY_MIN_CONFIDENCE ? DONE : FAILED, std::memory_order_release);
+}
@@ -0,0 +1,59 @@
+#ifndef LATENCY_CALIBRATOR_H
+#define LATENCY_CALIBRATOR_H
+
+// Round-trip latency measurement: output -> speaker/loopback -> input.
+//
+// While running, processBlock() plays a maximum length sequence (MLS,
+// order LATENCY_MLS_ORDER) for two periods plus the search range and
+// records the input; that is all the audio thread does. analyse() then
+// cross-correlates one period of the sequence against the second period
+// of the recording (which the first period has primed) at every lag up to
+// maxLatency, four lags' products at a time, and publishes the best lag.
+// The MLS autocorrelation is a single spike, so the peak stands out even
+// in a noisy room; a peak that does not is reported as a failure.
+//
+// analyse() is O(period * maxLatency): run it on an auxiliary task.
+
+#include <atomic>
+#include <vector>
+
+#define LATENCY_MLS_ORDER 12
+#define LATENCY_MLS_PERIOD ((1u << LATENCY_MLS_ORDER) - 1)
+
+class LatencyCalibrator {
+public:
+    enum State { IDLE, MEASURING, CAPTURED, DONE, FAILED };
+
+    LatencyCalibrator();
+
+    // Allocates; not real-time safe
+    void setup(unsigned int maxLatency, float level = 0.25f);
+
+    // ---- audio thread
+    void start();
+    // Writes the test signal into out while measuring; false otherwise
+    bool processBlock(const float* in, float* out, unsigned int n);
+
+    // ---- auxiliary task, once state() is CAPTURED
+    void analyse();
+
+    // ---- any thread
+    State state() const { return (State)currentState.load(std::memory_order_acquire); }
+    // Measured round trip in samples, valid once state() is DONE
+    unsigned int latency() const { return result; }
+    // Peak over RMS of the correlation of the last analysis
+    float confidence() const { return peakRatio; }
+
+private:
+    std::vector<float> sequence;   // one period, padded to a multiple of 4
+    std::vector<float> recording;
+    unsigned int maxLatency;
+    unsigned int position;
+    float level;
+
+    std::atomic<int> currentState;
+    unsigned int result;
+    float peakRatio;
+};
+
+#endif
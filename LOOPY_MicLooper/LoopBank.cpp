@@ -0,0 +1,108 @@
+#include "LoopBank.h"
+#include "LoopCodec.h"
+#include <cstring>
+
+LoopBank::LoopBank()
+    : storage(LOOP_STORE_LOSSLESS)
+{
+}
+
+void LoopBank::resize(unsigned int count, LoopStorage format)
+{
+    storage = format;
+    banks.resize(count);
+    for(unsigned int b = 0; b < count; b++)
+        discard(b);
+    samples.resize(LOOP_CHUNK_SIZE);
+    encoded.resize(loop_codec_bound(LOOP_CHUNK_SIZE));
+}
+
+void LoopBank::discard(unsigned int bank)
+{
+    Bank& b = banks[bank];
+    b.length = 0;
+    std::vector<uint8_t>().swap(b.data);
+    std::vector<uint32_t>(1, 0).swap(b.offsets);
+}
+
+bool LoopBank::store(unsigned int bank, const LoopBuffer& loop, unsigned int length)
+{
+    unsigned int pos = 0;
+    return storeSome(bank, loop, length, pos, ~0u);
+}
+
+unsigned int LoopBank::restore(unsigned int bank, LoopBuffer& loop)
+{
+    unsigned int pos = 0;
+    restoreSome(bank, loop, pos, ~0u);
+    return bank < banks.size() ? banks[bank].length : 0;
+}
+
+bool LoopBank::storeSome(unsigned int bank, const LoopBuffer& loop, unsigned int length, unsigned int& pos, unsigned int chunks)
+{
+    if(bank >= banks.size()) {
+        pos = length;
+        return false;
+    }
+    if(pos == 0)
+        discard(bank);
+    Bank& b = banks[bank];
+
+    for(; pos < length && chunks; pos += LOOP_CHUNK_SIZE, chunks--) {
+        unsigned int n = length - pos < LOOP_CHUNK_SIZE ? length - pos : LOOP_CHUNK_SIZE;
+        if(loop.copyOut(samples.data(), pos, n) < 0) {
+            discard(bank);
+            pos = length;
+            return false;
+        }
+        size_t bytes = n * sizeof(float);
+        if(storage == LOOP_STORE_RAW)
+            std::memcpy(encoded.data(), samples.data(), bytes);
+        else
+            bytes = loop_encode(samples.data(), n, encoded.data());
+        b.data.insert(b.data.end(), encoded.begin(), encoded.begin() + bytes);
+        b.offsets.push_back((uint32_t)b.data.size());
+    }
+    if(pos >= length) {
+        pos = length;
+        b.data.shrink_to_fit();
+        b.length = length;
+    }
+    return true;
+}
+
+void LoopBank::restoreSome(unsigned int bank, LoopBuffer& loop, unsigned int& pos, unsigned int chunks)
+{
+    if(pos == 0)
+        loop.clear();
+    if(bank >= banks.size())
+        return;
+    const Bank& b = banks[bank];
+
+    for(; pos < b.length && chunks; pos += LOOP_CHUNK_SIZE, chunks--) {
+        unsigned int n = b.length - pos < LOOP_CHUNK_SIZE ? b.length - pos : LOOP_CHUNK_SIZE;
+        unsigned int chunk = pos >> LOOP_CHUNK_SHIFT;
+        const uint8_t* data = b.data.data() + b.offsets[chunk];
+        size_t bytes = b.offsets[chunk + 1] - b.offsets[chunk];
+        bool decoded;
+        if(storage == LOOP_STORE_RAW) {
+            decoded = bytes == n * sizeof(float);
+            if(decoded)
+                std::memcpy(samples.data(), data, bytes);
+        } else
+            decoded = loop_decode(data, bytes, samples.data(), n);
+        if(!decoded) {
+            pos = b.length;
+            break;
+        }
+        // silent stretches stay on the shared zero chunk
+        for(unsigned int i = 0; i < n; i++)
+            if(samples[i] != 0.f)
+                loop.add(pos + i, samples[i]);
+        loop.endBlock();
+    }
+    if(pos >= b.length) {
+        pos = b.length;
+        loop.trim(b.length);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef LOOP_BANK_H
+#define LOOP_BANK_H
+
+// Loops that are stored but not playing, kept compressed (LoopCodec.h) or,
+// where memory is plentiful and bank switches should be quicker, raw.
+//
+// A bank holds one loop as encoded chunks of LOOP_CHUNK_SIZE samples, with
+// their offsets, so any chunk can be decoded on its own. store() copies the
+// loop out of a LoopBuffer through its lock-free reader and restore()
+// overdubs it into an empty one; both allocate and take milliseconds, so
+// they belong on an auxiliary task, never in render(). The LoopBuffer
+// being restored into must not be written by anyone else meanwhile.
+// storeSome() and restoreSome() do the same a few chunks at a time, for
+// jobs that yield in between (JobScheduler.h).
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+#include "LoopBuffer.h"
+#include "LoopStorage.h"
+
+class LoopBank {
+public:
+    LoopBank();
+
+    // Empties every bank
+    void resize(unsigned int banks, LoopStorage storage = LOOP_STORE_LOSSLESS);
+    unsigned int numBanks() const { return (unsigned int)banks.size(); }
+
+    // Compress loop positions [0, length) of `loop` into `bank`, replacing
+    // what it held
+    bool store(unsigned int bank, const LoopBuffer& loop, unsigned int length);
+    // Decode `bank` into `loop`, which is cleared first. Returns the loop
+    // length, 0 for an empty bank
+    unsigned int restore(unsigned int bank, LoopBuffer& loop);
+    void discard(unsigned int bank);
+
+    // Resumable forms: handle up to `chunks` chunks from loop position
+    // `pos` and advance it; finished once pos reaches the length (for
+    // restoring, length(bank), which is only set once storing finished).
+    // Starting from pos 0 replaces the bank / clears the loop.
+    bool storeSome(unsigned int bank, const LoopBuffer& loop, unsigned int length, unsigned int& pos, unsigned int chunks);
+    void restoreSome(unsigned int bank, LoopBuffer& loop, unsigned int& pos, unsigned int chunks);
+
+    unsigned int length(unsigned int bank) const { return banks[bank].length; }
+    size_t compressedBytes(unsigned int bank) const { return banks[bank].data.size(); }
+
+private:
+    struct Bank {
+        unsigned int length;
+        std::vector<uint8_t> data;
+        std::vector<uint32_t> offsets;   // per chunk, plus the end
+    };
+
+    std::vector<Bank> banks;
+    LoopStorage storage;
+    std::vector<float> samples;
+    std::vector<uint8_t> encoded;
+};
+
+#endif
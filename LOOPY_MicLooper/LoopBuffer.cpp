@@ -0,0 +1,436 @@
+#include "LoopBuffer.h"
+#include <cstring>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "NonFinite.h"
+
+LoopBuffer::LoopBuffer()
+    : numSamples(0)
+    , poolChunks(0)
+    , numReady(0)
+    , nextFresh(0)
+    , numFree(0)
+    , dropped(0)
+    , numLevels(0)
+    , origin(0)
+    , layoutSeq(0)
+    , numOpen(0)
+    , spanStart(0)
+    , spanLength(0)
+    , spanSamples(nullptr)
+    , spanChunk(LOOP_NO_CHUNK)
+    , closedLength(0)
+{
+    readCursor.start = writeCursor.start = 0;
+    readCursor.storage = writeCursor.storage = 0;
+    readCursor.length = writeCursor.length = 0;
+}
+
+LoopBuffer::~LoopBuffer()
+{
+    unmapPool();
+}
+
+void LoopBuffer::unmapPool()
+{
+    for(unsigned int k = 0; k < slabs.size(); k++)
+        if(slabs[k])
+            munmap(slabs[k], LOOP_SLAB_CHUNKS * LOOP_CHUNK_SIZE * sizeof(float));
+    slabs.clear();
+    numReady.store(0);
+}
+
+void LoopBuffer::resize(unsigned int logicalSamples, unsigned int physicalSamples, unsigned int readySamples)
+{
+    unsigned int chunks = (logicalSamples + LOOP_CHUNK_SIZE - 1) >> LOOP_CHUNK_SHIFT;
+    poolChunks = (physicalSamples + LOOP_CHUNK_SIZE - 1) >> LOOP_CHUNK_SHIFT;
+    numSamples = chunks << LOOP_CHUNK_SHIFT;
+
+    unmapPool();
+    slabs.assign((poolChunks + LOOP_SLAB_CHUNKS - 1) / LOOP_SLAB_CHUNKS, nullptr);
+    zeros.assign(LOOP_CHUNK_SIZE, 0.0f);
+    discard.assign(LOOP_CHUNK_SIZE, 0.0f);
+    refs.assign(poolChunks, 0);
+    freeList.resize(poolChunks);
+    numFree = 0;
+    nextFresh = 0;
+    dropped = 0;
+    grow(readySamples / LOOP_CHUNK_SIZE + (readySamples % LOOP_CHUNK_SIZE != 0));
+
+    std::vector<Slot> fresh(chunks);
+    slots.swap(fresh);
+    for(unsigned int c = 0; c < chunks; c++) {
+        slots[c].samples = zeros.data();
+        slots[c].chunk = LOOP_NO_CHUNK;
+        slots[c].seq.store(0, std::memory_order_relaxed);
+    }
+    numLevels = 0;
+    origin = 0;
+    numOpen = 0;
+    layoutChanged();
+}
+
+unsigned int LoopBuffer::grow(unsigned int chunks)
+{
+    const size_t bytes = LOOP_SLAB_CHUNKS * LOOP_CHUNK_SIZE * sizeof(float);
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    unsigned int ready = numReady.load(std::memory_order_relaxed);
+    for(unsigned int added = 0; added < chunks && ready < poolChunks; added += LOOP_SLAB_CHUNKS) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED)
+            break;
+        // fault every page in here, not in the audio thread (a no-op if
+        // the process has locked its future memory)
+        for(size_t b = 0; b < bytes; b += page)
+            static_cast<volatile char*>(p)[b] = 0;
+        slabs[ready / LOOP_SLAB_CHUNKS] = static_cast<float*>(p);
+        ready = ready + LOOP_SLAB_CHUNKS < poolChunks ? ready + LOOP_SLAB_CHUNKS : poolChunks;
+        numReady.store(ready, std::memory_order_release);
+    }
+    return ready;
+}
+
+// ------------------------------------------------------
+// Position -> slot sample translation
+
+unsigned int LoopBuffer::translate(unsigned int pos, const Level* lv, unsigned int n, unsigned int origin, Cursor& c)
+{
+    unsigned int base = origin;
+    unsigned int p = pos;
+    for(unsigned int k = 0; k < n; k++) {
+        unsigned int repeat = p / lv[k].length;
+        base += repeat * lv[k].stride;
+        p -= repeat * lv[k].length;
+    }
+    c.start = pos - p;
+    c.storage = base;
+    c.length = n ? lv[n - 1].length : 0xffffffffu - c.start;
+    return base + p;
+}
+
+unsigned int LoopBuffer::relocate(unsigned int pos, Cursor& c) const
+{
+    return translate(pos, levels, numLevels, origin, c);
+}
+
+void LoopBuffer::layoutChanged()
+{
+    readCursor.length = 0;
+    writeCursor.length = 0;
+    spanLength = 0;
+    closedLength = 0;
+}
+
+// ------------------------------------------------------
+// Chunk references
+
+void LoopBuffer::release(Slot& slot)
+{
+    if(slot.chunk != LOOP_NO_CHUNK && --refs[slot.chunk] == 0)
+        freeList[numFree++] = slot.chunk;
+    slot.chunk = LOOP_NO_CHUNK;
+    slot.samples = zeros.data();
+}
+
+// A free chunk: a released one, or one never used from a published slab
+unsigned int LoopBuffer::takeChunk()
+{
+    if(numFree)
+        return freeList[--numFree];
+    if(nextFresh < numReady.load(std::memory_order_acquire))
+        return nextFresh++;
+    return LOOP_NO_CHUNK;
+}
+
+// Give the slot a chunk of its own, copying what it showed until now
+void LoopBuffer::makeExclusive(Slot& slot)
+{
+    if(slot.chunk != LOOP_NO_CHUNK && refs[slot.chunk] == 1)
+        return;
+    unsigned int fresh = takeChunk();
+    if(fresh == LOOP_NO_CHUNK)
+        return;
+    float* samples = chunkSamples(fresh);
+    std::memcpy(samples, slot.samples, LOOP_CHUNK_SIZE * sizeof(float));
+    release(slot);
+    slot.chunk = fresh;
+    slot.samples = samples;
+    refs[fresh] = 1;
+}
+
+// Open the chunk `pos` lands in; the rest of it, or of the repeat if that
+// ends first, becomes the span add() writes through
+float* LoopBuffer::openSpan(unsigned int pos, unsigned int& count)
+{
+    unsigned int i = locate(pos, writeCursor);
+    unsigned int within = i & (LOOP_CHUNK_SIZE - 1);
+    float* samples = openChunk(i >> LOOP_CHUNK_SHIFT);
+    unsigned int run = LOOP_CHUNK_SIZE - within;
+    unsigned int repeat = writeCursor.length - (pos - writeCursor.start);
+    spanStart = pos;
+    spanLength = run < repeat ? run : repeat;
+    spanSamples = samples + within;
+    spanChunk = i >> LOOP_CHUNK_SHIFT;
+    closedLength = 0;
+    if(count > spanLength)
+        count = spanLength;
+    return spanSamples;
+}
+
+void LoopBuffer::addSlow(unsigned int pos, float value)
+{
+    unsigned int count = 1;
+    *writeSpan(pos, count) += value;
+}
+
+// Open a chunk for writing until endBlock(); returns where its writes go
+float* LoopBuffer::openChunk(unsigned int chunk)
+{
+    bool isOpen = false;
+    for(unsigned int k = 0; k < numOpen; k++)
+        isOpen = isOpen || openChunks[k] == chunk;
+
+    Slot& slot = slots[chunk];
+    if(!isOpen) {
+        if(numOpen == LOOP_MAX_OPEN)
+            endBlock();
+        // odd: readers back off until endBlock()
+        slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        openChunks[numOpen++] = chunk;
+        makeExclusive(slot);
+        if(slot.chunk == LOOP_NO_CHUNK || refs[slot.chunk] != 1)
+            dropped++;
+    }
+    return (slot.chunk != LOOP_NO_CHUNK && refs[slot.chunk] == 1) ? slot.samples : discard.data();
+}
+
+void LoopBuffer::clear()
+{
+    endBlock();
+    for(unsigned int c = 0; c < slots.size(); c++) {
+        if(slots[c].chunk == LOOP_NO_CHUNK)
+            continue;
+        openChunk(c);
+        release(slots[c]);
+        endBlock();
+    }
+
+    layoutSeq.store(layoutSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    numLevels = 0;
+    origin = 0;
+    layoutSeq.store(layoutSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    layoutChanged();
+}
+
+void LoopBuffer::trim(unsigned int length)
+{
+    endBlock();
+    Cursor c;
+    unsigned int extent = length ? translate(length - 1, levels, numLevels, origin, c) + 1 : 0;
+    for(unsigned int s = 0; s < slots.size(); s++) {
+        // chunks wholly before the start or past the end
+        if(slots[s].chunk == LOOP_NO_CHUNK
+           || (s >= origin >> LOOP_CHUNK_SHIFT && s < (extent + LOOP_CHUNK_SIZE - 1) >> LOOP_CHUNK_SHIFT))
+            continue;
+        openChunk(s);
+        release(slots[s]);
+        endBlock();
+    }
+    layoutChanged();
+}
+
+bool LoopBuffer::multiply(unsigned int length, unsigned int times)
+{
+    if(times < 2 || length == 0)
+        return times == 1;
+    if(numLevels == LOOP_MAX_LEVELS)
+        return false;
+
+    Cursor c;
+    unsigned int extent = translate(length - 1, levels, numLevels, origin, c) + 1;
+    unsigned int used = (extent + LOOP_CHUNK_SIZE - 1) >> LOOP_CHUNK_SHIFT;
+    if((unsigned long long)used * times > slots.size())
+        return false;
+
+    // chunks opened this block may be about to become shared
+    endBlock();
+    layoutSeq.store(layoutSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // repeats reference the chunks of the first one
+    for(unsigned int r = 1; r < times; r++) {
+        for(unsigned int s = 0; s < used; s++) {
+            Slot& dst = slots[r * used + s];
+            const Slot& src = slots[s];
+            dst.seq.store(dst.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            release(dst);
+            dst.chunk = src.chunk;
+            dst.samples = src.samples;
+            if(src.chunk != LOOP_NO_CHUNK)
+                refs[src.chunk]++;
+            dst.seq.store(dst.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    }
+
+    for(unsigned int k = numLevels; k > 0; k--)
+        levels[k] = levels[k - 1];
+    levels[0].length = length;
+    levels[0].stride = used << LOOP_CHUNK_SHIFT;
+    numLevels++;
+
+    layoutSeq.store(layoutSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    layoutChanged();
+    return true;
+}
+
+bool LoopBuffer::setStart(unsigned int start)
+{
+    if(numLevels || origin + start >= numSamples)
+        return false;
+    endBlock();
+    layoutSeq.store(layoutSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    origin += start;
+    layoutSeq.store(layoutSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    layoutChanged();
+    return true;
+}
+
+// ------------------------------------------------------
+// NaN/Inf guard
+
+bool LoopBuffer::scrub(unsigned int start, unsigned int count, unsigned int ringSize)
+{
+    if(count > ringSize)
+        count = ringSize;
+
+    // bulk check one contiguous run at a time
+    bool bad = false;
+    Cursor c = writeCursor;
+    for(unsigned int done = 0; done < count && !bad; ) {
+        unsigned int pos = (start + done) % ringSize;
+        unsigned int i = locate(pos, c);
+        unsigned int run = LOOP_CHUNK_SIZE - (i & (LOOP_CHUNK_SIZE - 1));
+        if(run > c.length - (pos - c.start)) run = c.length - (pos - c.start);
+        if(run > ringSize - pos) run = ringSize - pos;
+        if(run > count - done) run = count - done;
+        bad = !all_finite(&slots[i >> LOOP_CHUNK_SHIFT].samples[i & (LOOP_CHUNK_SIZE - 1)], run);
+        done += run;
+    }
+    if(!bad)
+        return false;
+
+    unsigned int k = 0;
+    while(k < count && is_finite(read((start + k) % ringSize)))
+        k++;
+    for(; k < count; k++) {
+        unsigned int one = 1;
+        *writeSpan((start + k) % ringSize, one) = 0.0f;
+    }
+    return true;
+}
+
+// ------------------------------------------------------
+// Readers
+
+// One chunk's run under its seqlock; `seq` is the even count it was
+// copied at. False if the chunk stayed busy too long.
+bool LoopBuffer::copyRun(const CopyRun& r, float* dst, uint32_t& seq, int& retries) const
+{
+    const Slot& slot = slots[r.slot];
+    for(int tries = 0; tries < LOOP_COPY_TRIES; tries++) {
+        uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if(before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy(dst + r.offset, slot.samples + r.within, r.length * sizeof(float));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.seq.load(std::memory_order_relaxed) == before) {
+            seq = before;
+            return true;
+        }
+        retries++;
+    }
+    return false;
+}
+
+int LoopBuffer::copyOut(float* dst, unsigned int start, unsigned int count) const
+{
+    // the runs of this copy and their counters, grown once per thread
+    static thread_local std::vector<CopyRun> runs;
+    static thread_local std::vector<uint32_t> seqs;
+    int retries = 0;
+
+    for(int attempt = 0; attempt < LOOP_COPY_TRIES; attempt++) {
+        // the repeat layout, under its own seqlock
+        uint32_t layout = layoutSeq.load(std::memory_order_acquire);
+        if(layout & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        Level lv[LOOP_MAX_LEVELS];
+        unsigned int n = numLevels;
+        if(n > LOOP_MAX_LEVELS)
+            n = LOOP_MAX_LEVELS;
+        unsigned int o = origin;
+        std::memcpy(lv, levels, sizeof(lv));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(layoutSeq.load(std::memory_order_relaxed) != layout) {
+            retries++;
+            continue;
+        }
+
+        runs.clear();
+        Cursor c = { 0, 0, 0 };
+        unsigned int end = start + count;
+        for(unsigned int pos = start; pos < end; ) {
+            unsigned int offset = pos - c.start;
+            unsigned int i = offset < c.length ? c.storage + offset : translate(pos, lv, n, o, c);
+            if((i >> LOOP_CHUNK_SHIFT) >= slots.size())
+                return -1;
+            CopyRun r;
+            r.slot = i >> LOOP_CHUNK_SHIFT;
+            r.within = i & (LOOP_CHUNK_SIZE - 1);
+            r.offset = pos - start;
+            r.length = LOOP_CHUNK_SIZE - r.within;
+            if(r.length > c.length - (pos - c.start)) r.length = c.length - (pos - c.start);
+            if(r.length > end - pos) r.length = end - pos;
+            runs.push_back(r);
+            pos += r.length;
+        }
+
+        // Each run as it was between two blocks, then the whole range
+        // checked again: runs that moved meanwhile are copied again until
+        // a check finds none, so every run still held what was copied at
+        // the start of that last check
+        seqs.resize(runs.size());
+        for(size_t k = 0; k < runs.size(); k++)
+            if(!copyRun(runs[k], dst, seqs[k], retries))
+                return -1;
+        bool moved = true;
+        for(int check = 0; moved; check++) {
+            if(check == LOOP_COPY_TRIES)
+                return -1;
+            moved = false;
+            for(size_t k = 0; k < runs.size(); k++) {
+                if(slots[runs[k].slot].seq.load(std::memory_order_acquire) == seqs[k])
+                    continue;
+                if(!copyRun(runs[k], dst, seqs[k], retries))
+                    return -1;
+                moved = true;
+                retries++;
+            }
+        }
+
+        // a multiply during the copy moves positions around: start over
+        if(layoutSeq.load(std::memory_order_acquire) == layout)
+            return retries;
+        retries++;
+    }
+    return -1;
+}
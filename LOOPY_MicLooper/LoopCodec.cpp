@@ -0,0 +1,183 @@
+#include "LoopCodec.h"
+#include <cstring>
+#include "Simd.h"
+
+namespace {
+
+// LSB-first bit packing, 64 bits at a time
+struct BitWriter {
+    uint8_t* out;
+    uint64_t acc;
+    unsigned int bits;
+
+    void put(uint32_t value, unsigned int n)    // n <= 32
+    {
+        acc |= (uint64_t)value << bits;
+        bits += n;
+        while(bits >= 8) {
+            *out++ = (uint8_t)acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    void flush()
+    {
+        if(bits)
+            *out++ = (uint8_t)acc;
+        acc = 0;
+        bits = 0;
+    }
+};
+
+struct BitReader {
+    const uint8_t* in;
+    const uint8_t* end;
+    uint64_t acc;
+    unsigned int bits;
+
+    void refill()
+    {
+        while(bits <= 56 && in < end) {
+            acc |= (uint64_t)*in++ << bits;
+            bits += 8;
+        }
+    }
+    uint32_t get(unsigned int n)                // n <= 32, after refill()
+    {
+        uint32_t v = n ? (uint32_t)(acc & ((1ull << n) - 1)) : 0;
+        acc >>= n;
+        bits -= n;
+        return v;
+    }
+};
+
+// Rice parameter with the smallest estimated size for a partition, from a
+// histogram of residual bit lengths (a residual b bits long is taken as
+// 1.5 * 2^(b - 1)). Near zero crossings the float exponent moves a lot, so
+// the residuals have long tails and the mean would overshoot.
+unsigned int riceParameter(const unsigned int* hist, unsigned int count)
+{
+    unsigned int best = LOOP_CODEC_RAW;
+    uint64_t bestBits = (uint64_t)count * 32;
+    for(unsigned int k = 0; k < LOOP_CODEC_RAW; k++) {
+        uint64_t total = (uint64_t)hist[0] * (k + 1);
+        for(unsigned int b = 1; b <= 32; b++) {
+            if(!hist[b])
+                continue;
+            uint64_t q = (3ull << (b - 1)) >> (k + 1);
+            total += (uint64_t)hist[b] * (q >= LOOP_CODEC_ESCAPE ? LOOP_CODEC_ESCAPE + 32 : q + 1 + k);
+        }
+        if(total < bestBits) {
+            bestBits = total;
+            best = k;
+        }
+    }
+    return best;
+}
+
+inline float fromOrdered(uint32_t m)
+{
+    uint32_t bits = m ^ ((uint32_t)((int32_t)m >> 31) >> 1);
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+} // namespace
+
+size_t loop_encode(const float* in, unsigned int n, uint8_t* out)
+{
+    BitWriter w = { out, 0, 0 };
+    float residual[LOOP_CODEC_PARTITION];   // raw bits, as vresidual() leaves them
+    float prev = 0.f;
+
+    for(unsigned int start = 0; start < n; start += LOOP_CODEC_PARTITION) {
+        unsigned int count = n - start < LOOP_CODEC_PARTITION ? n - start : LOOP_CODEC_PARTITION;
+        const float* x = in + start;
+
+        // residuals, four at a time once x[i - 1] is in range
+        unsigned int i = 0;
+        for(; i < count && i < 4; i++) {
+            uint32_t z = vresidual(x[i], i ? x[i - 1] : prev);
+            std::memcpy(&residual[i], &z, sizeof(z));
+        }
+        for(; i + 4 <= count; i += 4)
+            vresidual(vf4::load(x + i), vf4::load(x + i - 1)).store(residual + i);
+        for(; i < count; i++) {
+            uint32_t z = vresidual(x[i], x[i - 1]);
+            std::memcpy(&residual[i], &z, sizeof(z));
+        }
+        prev = x[count - 1];
+
+        unsigned int hist[33] = { 0 };
+        for(i = 0; i < count; i++) {
+            uint32_t z;
+            std::memcpy(&z, &residual[i], sizeof(z));
+            hist[z ? 32 - __builtin_clz(z) : 0]++;
+        }
+
+        unsigned int k = riceParameter(hist, count);
+        w.put(k, 5);
+        for(i = 0; i < count; i++) {
+            uint32_t z;
+            std::memcpy(&z, &residual[i], sizeof(z));
+            if(k == LOOP_CODEC_RAW) {
+                w.put(z, 32);
+                continue;
+            }
+            uint32_t q = z >> k;
+            if(q >= LOOP_CODEC_ESCAPE) {
+                w.put((1u << LOOP_CODEC_ESCAPE) - 1, LOOP_CODEC_ESCAPE);
+                w.put(z, 32);
+                continue;
+            }
+            w.put((1u << q) - 1, q + 1);    // q ones and a zero
+            if(k)
+                w.put(z & ((1u << k) - 1), k);
+        }
+    }
+    w.flush();
+    return (size_t)(w.out - out);
+}
+
+bool loop_decode(const uint8_t* in, size_t size, float* out, unsigned int n)
+{
+    BitReader r = { in, in + size, 0, 0 };
+    uint32_t m = 0;
+
+    for(unsigned int start = 0; start < n; start += LOOP_CODEC_PARTITION) {
+        unsigned int count = n - start < LOOP_CODEC_PARTITION ? n - start : LOOP_CODEC_PARTITION;
+        r.refill();
+        if(r.bits < 5)
+            return false;
+        unsigned int k = r.get(5);
+
+        for(unsigned int i = 0; i < count; i++) {
+            r.refill();
+            uint32_t z;
+            if(k == LOOP_CODEC_RAW) {
+                if(r.bits < 32)
+                    return false;
+                z = r.get(32);
+                m += (z >> 1) ^ (0u - (z & 1));
+                out[start + i] = fromOrdered(m);
+                continue;
+            }
+            unsigned int q = __builtin_ctzll(~r.acc);
+            if(q >= LOOP_CODEC_ESCAPE) {
+                if(r.bits < LOOP_CODEC_ESCAPE + 32)
+                    return false;
+                r.get(LOOP_CODEC_ESCAPE);
+                z = r.get(32);
+            } else {
+                if(r.bits < q + 1 + k)
+                    return false;
+                r.get(q + 1);
+                z = (q << k) | r.get(k);
+            }
+            m += (z >> 1) ^ (0u - (z & 1));
+            out[start + i] = fromOrdered(m);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef LOOP_CODEC_H
+#define LOOP_CODEC_H
+
+// Lossless codec for loop audio, for loops that are stored but not playing.
+//
+// Each float's bits are mapped to an integer that sorts like the float,
+// predicted from the previous sample, and the zigzagged residual is Rice
+// coded with a parameter chosen per partition of LOOP_CODEC_PARTITION
+// samples (or stored raw if that is smaller). The residuals are computed
+// four samples at a time (vresidual() in Simd.h); the bit packing and the
+// decoder's running sum are scalar. Silence codes to about one bit per
+// sample. Busy material only gets to about 75% of its float size: after
+// gain and filtering the low mantissa bits are noise, and only the sign and
+// exponent are predictable. Decoding gives back the exact bits, NaNs and
+// signed zeros included.
+//
+// Not real-time: meant for an auxiliary task.
+
+#include <cstddef>
+#include <stdint.h>
+
+#define LOOP_CODEC_PARTITION 256   // samples per Rice parameter
+#define LOOP_CODEC_ESCAPE    24    // quotients this long store the raw residual
+#define LOOP_CODEC_RAW       31    // Rice parameter marking a raw partition
+
+// Upper bound on the encoded size of n samples, in bytes
+inline size_t loop_codec_bound(unsigned int n)
+{
+    return (size_t)n * 4 + (n / LOOP_CODEC_PARTITION + 1) + 8;
+}
+
+// Encode n samples into out (at least loop_codec_bound(n) bytes); returns
+// the encoded size
+size_t loop_encode(const float* in, unsigned int n, uint8_t* out);
+
+// Decode n samples; false if the data runs out first
+bool loop_decode(const uint8_t* in, size_t size, float* out, unsigned int n);
+
+#endif
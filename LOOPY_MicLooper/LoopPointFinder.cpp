@@ -0,0 +1,203 @@
+#include "LoopPointFinder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// The normalised correlation a length must reach to replace the hand-set one
+#define LOOP_POINT_MIN_CORRELATION 0.7f
+// Candidates are compared over at least this fraction of the window, and
+// scored down with the square root of the fraction they get: a short
+// overlap matches too easily (a decaying note matches itself a few periods
+// on)
+#define LOOP_POINT_MIN_OVERLAP     8
+// Shorter corrections win among near-equal peaks (beats repeat within a bar)
+#define LOOP_POINT_LENGTH_BIAS     0.05f
+// Samples over which the seam is matched, and how much worse than the best
+// an earlier start may match and still be preferred
+#define LOOP_POINT_SEAM            64
+#define LOOP_POINT_SEAM_SLACK      1.05
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LoopPointFinder::LoopPointFinder()
+    : search(0)
+    , window(0)
+    , budget(0.0)
+    , stage(IDLE)
+    , takeLength(0)
+    , tailStart(0)
+    , take(-1)
+    , started(0.0)
+    , readyTake(-1)
+    , bestStart(0)
+    , bestLength(0)
+    , bestScore(0.f)
+    , numTimeouts(0)
+{
+}
+
+void LoopPointFinder::setup(unsigned int searchSamples, unsigned int windowSamples, float budgetSeconds)
+{
+    search = searchSamples;
+    window = windowSamples;
+    budget = budgetSeconds;
+
+    // no circular wrap for any lag of the window against the tail
+    unsigned int n = 4;
+    while(n < search + window)
+        n <<= 1;
+    fft.resize(n);
+    head.assign(n, 0.f);
+    tail.assign(n, 0.f);
+    correlation.assign(n, 0.f);
+    headBins.resize(fft.numBins());
+    tailBins.resize(fft.numBins());
+    headEnergy.assign(window + 1, 0.0);
+    tailEnergy.assign(search + 1, 0.0);
+    stage.store(IDLE);
+    readyTake.store(-1);
+}
+
+bool LoopPointFinder::start(unsigned int length, int takeNumber)
+{
+    if(head.empty() || stage.load(std::memory_order_acquire) != IDLE)
+        return false;
+    // candidates must leave some of the window to compare, and not overlap it
+    unsigned int first = length > search + window ? length - search : window;
+    if(first + window / LOOP_POINT_MIN_OVERLAP >= length)
+        return false;
+    takeLength = length;
+    tailStart = first;
+    take = takeNumber;
+    stage.store(COPY, std::memory_order_release);
+    return true;
+}
+
+void LoopPointFinder::finish(bool found)
+{
+    if(found)
+        readyTake.store(take, std::memory_order_release);
+    stage.store(IDLE, std::memory_order_release);
+}
+
+bool LoopPointFinder::step(const LoopBuffer& loop)
+{
+    Stage current = (Stage)stage.load(std::memory_order_acquire);
+    if(current == IDLE)
+        return true;
+    if(current == COPY)
+        started = nowSeconds();
+    else if(nowSeconds() - started > budget) {
+        numTimeouts++;
+        finish(false);
+        return true;
+    }
+
+    unsigned int tailLength = takeLength - tailStart;
+    switch(current) {
+    case COPY:
+        std::fill(head.begin(), head.end(), 0.f);
+        std::fill(tail.begin(), tail.end(), 0.f);
+        if(loop.copyOut(head.data(), 0, window) < 0 || loop.copyOut(tail.data(), tailStart, tailLength) < 0) {
+            finish(false);
+            return true;
+        }
+        for(unsigned int i = 0; i < window; i++)
+            headEnergy[i + 1] = headEnergy[i] + (double)head[i] * head[i];
+        for(unsigned int i = 0; i < tailLength; i++)
+            tailEnergy[i + 1] = tailEnergy[i] + (double)tail[i] * tail[i];
+        stage.store(HEAD, std::memory_order_relaxed);
+        return false;
+
+    case HEAD:
+        fft.forward(head.data(), headBins.data());
+        stage.store(TAIL, std::memory_order_relaxed);
+        return false;
+
+    case TAIL:
+        fft.forward(tail.data(), tailBins.data());
+        stage.store(CORRELATE, std::memory_order_relaxed);
+        return false;
+
+    case CORRELATE:
+        // conj(H) T: the correlation of the opening at every tail offset
+        for(unsigned int k = 0; k < fft.numBins(); k++) {
+            const Complex h = headBins[k];
+            const Complex t = tailBins[k];
+            tailBins[k].re = h.re * t.re + h.im * t.im;
+            tailBins[k].im = h.re * t.im - h.im * t.re;
+        }
+        fft.inverse(tailBins.data(), correlation.data());
+        stage.store(LENGTH, std::memory_order_relaxed);
+        return false;
+
+    case LENGTH: {
+        float best = -1.f, bestCorrelation = 0.f;
+        unsigned int bestOffset = 0;
+        for(unsigned int d = 0; d + window / LOOP_POINT_MIN_OVERLAP <= tailLength; d++) {
+            unsigned int n = tailLength - d < window ? tailLength - d : window;
+            double energy = headEnergy[n] * (tailEnergy[d + n] - tailEnergy[d]);
+            if(energy <= 0.0)
+                continue;
+            float c = (float)(correlation[d] / fft.size() / std::sqrt(energy));
+            float score = c * std::sqrt((float)n / window)
+                          - LOOP_POINT_LENGTH_BIAS * (float)(tailLength - d) / search;
+            if(score > best) {
+                best = score;
+                bestCorrelation = c;
+                bestOffset = d;
+            }
+        }
+        bestScore = bestCorrelation;
+        if(bestCorrelation < LOOP_POINT_MIN_CORRELATION) {
+            finish(false);
+            return true;
+        }
+        bestLength = tailStart + bestOffset;
+        stage.store(SEAM, std::memory_order_relaxed);
+        return false;
+    }
+
+    case SEAM: {
+        // squared difference of the two copies over LOOP_POINT_SEAM samples
+        // from every start the head and tail both cover
+        unsigned int offset = bestLength - tailStart;
+        unsigned int span = tailLength - offset < window ? tailLength - offset : window;
+        if(span <= LOOP_POINT_SEAM) {
+            bestStart = 0;
+            finish(true);
+            return true;
+        }
+        unsigned int starts = span - LOOP_POINT_SEAM + 1;
+        std::vector<float>& error = correlation;
+        double sum = 0.0;
+        for(unsigned int t = 0; t < span; t++) {
+            float diff = head[t] - tail[offset + t];
+            sum += (double)diff * diff;
+            if(t >= LOOP_POINT_SEAM) {
+                float old = head[t - LOOP_POINT_SEAM] - tail[offset + t - LOOP_POINT_SEAM];
+                sum -= (double)old * old;
+            }
+            if(t + 1 >= LOOP_POINT_SEAM)
+                error[t + 1 - LOOP_POINT_SEAM] = (float)(sum > 0.0 ? sum : 0.0);
+        }
+        float least = error[0];
+        for(unsigned int s = 1; s < starts; s++)
+            if(error[s] < least)
+                least = error[s];
+        unsigned int s = 0;
+        while(error[s] > LOOP_POINT_SEAM_SLACK * least + 1e-9f)
+            s++;
+        bestStart = s;
+        finish(true);
+        return true;
+    }
+
+    default:
+        finish(false);
+        return true;
+    }
+}
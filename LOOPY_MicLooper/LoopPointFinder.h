@@ -0,0 +1,87 @@
+#ifndef LOOP_POINT_FINDER_H
+#define LOOP_POINT_FINDER_H
+
+// Refines a first take closed by hand: stopped a little late, its end
+// runs into the start of the phrase again, and the loop clicks at the seam
+// and drifts against the phrase.
+//
+// The opening `window` samples of the take are cross-correlated, by FFT,
+// against its last `search` samples; the normalised peak is where the
+// opening comes round again, which is the loop length. The start is then
+// put where the two copies agree best over a short stretch, so the seam
+// falls where it cannot be heard. Only a take stopped late, by more than
+// an eighth of the window, can be fixed: when it was stopped early the
+// material is not there, no peak stands out and the hand-set length is
+// kept.
+//
+// The work is split into steps of at most one FFT for a job
+// (JobScheduler.h). A search that is not finished within its time budget
+// gives up. The result is published through ready(), with the take it
+// belongs to, for render() to apply at a block boundary.
+
+#include <atomic>
+#include <vector>
+#include "Fft.h"
+#include "LoopBuffer.h"
+
+class LoopPointFinder {
+public:
+    LoopPointFinder();
+
+    // Lengths up to `search` samples shorter than the take are tried,
+    // matching `window` samples; allocates, not real-time safe
+    void setup(unsigned int search, unsigned int window, float budgetSeconds);
+
+    // ---- audio thread
+    // A take of `length` samples was closed as take number `take`; false if
+    // a search is still running
+    bool start(unsigned int length, int take);
+
+    // ---- the job
+    // One step of the search over `loop`; true once finished
+    bool step(const LoopBuffer& loop);
+
+    // ---- any thread
+    // The take of the last successful search, or -1; the results below are
+    // published by it
+    int ready() const { return readyTake.load(std::memory_order_acquire); }
+    void consume() { readyTake.store(-1, std::memory_order_relaxed); }
+    unsigned int loopStart() const { return bestStart; }
+    unsigned int loopLength() const { return bestLength; }
+    // Normalised correlation of the last search's peak, 0..1
+    float confidence() const { return bestScore; }
+    // Searches given up for lack of time
+    unsigned int timeouts() const { return numTimeouts; }
+
+private:
+    enum Stage { IDLE, COPY, HEAD, TAIL, CORRELATE, LENGTH, SEAM };
+
+    void finish(bool found);
+
+    unsigned int search;
+    unsigned int window;
+    double budget;
+
+    Fft fft;
+    std::vector<float> head;        // opening window, zero padded
+    std::vector<float> tail;        // last `search` samples, zero padded
+    std::vector<Complex> headBins;
+    std::vector<Complex> tailBins;
+    std::vector<float> correlation;
+    std::vector<double> headEnergy; // prefix sums of squares
+    std::vector<double> tailEnergy;
+
+    std::atomic<int> stage;
+    unsigned int takeLength;
+    unsigned int tailStart;         // take position of tail[0]
+    int take;
+    double started;
+
+    std::atomic<int> readyTake;
+    unsigned int bestStart;
+    unsigned int bestLength;
+    float bestScore;
+    unsigned int numTimeouts;
+};
+
+#endif
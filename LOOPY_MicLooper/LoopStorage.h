@@ -0,0 +1,12 @@
+#ifndef LOOP_STORAGE_H
+#define LOOP_STORAGE_H
+
+// How LoopBank keeps stored loops, on its own so that EngineConfig.h can
+// name it without pulling in the bank and the buffer
+
+enum LoopStorage {
+    LOOP_STORE_LOSSLESS,            // LoopCodec, exact
+    LOOP_STORE_RAW                  // plain floats
+};
+
+#endif
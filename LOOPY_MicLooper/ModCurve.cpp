@@ -0,0 +1,79 @@
+#include "ModCurve.h"
+#include <cmath>
+
+ModCurve::ModCurve(unsigned int maxTicks, unsigned int curveStride)
+    : stride(curveStride > 0 ? curveStride : 1)
+    , length(0)
+    , rendered(0)
+    , numPoints(0)
+    , held(false)
+    , invStride(1.0f / (float)stride)
+    , cursor(0.0f)
+    , scratch()
+{
+    // one extra point so the last segment can interpolate back to the start
+    points.resize(maxTicks / stride + 2, 0.0f);
+}
+
+void ModCurve::beginRender(const lfoparams* lp, float syncPhase, unsigned int ticksPerPass)
+{
+    numPoints = (ticksPerPass + stride - 1) / stride;
+    if(ticksPerPass == 0 || numPoints + 1 > points.size()) {
+        invalidate();
+        return;
+    }
+
+    // Wind the copy one tick back so its first run_lfo() lands on syncPhase.
+    // A morph still gliding is rendered where it is heading, or every pass
+    // of the cache would replay the glide.
+    scratch = *lp;
+    scratch.morph = scratch.morph_target;
+    set_lfo_phase(&scratch, syncPhase - scratch.phase_inc);
+    length = ticksPerPass;
+    rendered = 0;
+    held = false;
+}
+
+void ModCurve::renderSome(unsigned int maxTicks)
+{
+    if(length == 0 || held)
+        return;
+    for(unsigned int i = 0; i < maxTicks && rendered < length; i++) {
+        float value = run_lfo(&scratch);
+        if(rendered % stride == 0)
+            points[rendered / stride] = value;
+        rendered++;
+    }
+    // the pass holds whole LFO cycles, so the curve wraps onto its start
+    if(rendered >= length)
+        points[numPoints] = points[0];
+}
+
+bool ModCurve::next(float& value)
+{
+    if(length == 0)
+        return false;
+
+    cursor += 1.0f;
+    if(cursor >= (float)length)
+        cursor -= (float)length;
+    if(cursor < 0.0f)
+        cursor += (float)length;
+    if(rendered < length || held)
+        return false;
+
+    float pos = cursor * invStride;
+    unsigned int i = (unsigned int)pos;
+    if(i >= numPoints)
+        i = numPoints - 1;
+    float frac = pos - (float)i;
+
+    // the last point may sit less than a full stride before the wrap
+    unsigned int segment = (i + 1 < numPoints) ? stride : length - i * stride;
+    frac *= (float)stride / (float)segment;
+    if(frac > 1.0f)
+        frac = 1.0f;
+
+    value = points[i] + frac * (points[i + 1] - points[i]);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef MOD_CURVE_H
+#define MOD_CURVE_H
+
+#include <vector>
+#include "lfo.h"
+
+// Cache of one loop pass of a phase-locked LFO. The curve is rendered from a
+// private copy of the oscillator a slice at a time (so no block pays for the
+// whole pass), stored every `stride` ticks, and then replayed with a cursor
+// and linear interpolation instead of running the oscillator.
+class ModCurve {
+public:
+    ModCurve(unsigned int maxTicks, unsigned int curveStride);
+
+    // Start (re)rendering `ticksPerPass` ticks of lp, beginning at syncPhase.
+    // Call whenever rate or shape change; the cache is unusable until ready().
+    void beginRender(const lfoparams* lp, float syncPhase, unsigned int ticksPerPass);
+    // Render at most maxTicks more ticks of the pass.
+    void renderSome(unsigned int maxTicks);
+    void invalidate() { rendered = 0; length = 0; held = false; }
+    bool ready() const { return length > 0 && rendered >= length && !held; }
+    // Stop replaying and rendering until the next beginRender(), e.g. while
+    // the shape is still moving; the cursor keeps moving meanwhile.
+    void hold() { held = true; }
+    bool isHeld() const { return held; }
+
+    // Move the cursor to `position` ticks from the loop start (fractional,
+    // may be negative by up to one tick, see retriggerLfo()).
+    void restart(float position) { cursor = position; }
+    // Advance one tick. Returns true and the cached LFO value there (like
+    // run_lfo()) once the curve is ready; while it is still rendering only
+    // the cursor moves, so it stays aligned with the live oscillator.
+    bool next(float& value);
+    float position() const { return cursor; }
+
+private:
+    unsigned int stride;
+    unsigned int length;     // ticks per pass, 0 when invalid
+    unsigned int rendered;   // ticks rendered so far
+    unsigned int numPoints;
+    bool held;
+    float invStride;
+    float cursor;
+
+    lfoparams scratch;       // oscillator copy the curve is rendered from
+    std::vector<float> points;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "ModMatrix.h"
+#include "Tables.h"
+
+ModMatrix::ModMatrix()
+    : numRoutes(0)
+{
+    for(unsigned int s = 0; s < MOD_NUM_SOURCES; s++)
+        sources[s] = 0.f;
+    sources[MOD_SRC_NONE] = 1.f;
+    for(unsigned int d = 0; d < MOD_DST_PADDED; d++) {
+        base[d] = 0.f;
+        minValues[d] = 0.f;
+        maxValues[d] = 1.f;
+        values[d] = 0.f;
+    }
+}
+
+void ModMatrix::setRange(ModDestination dst, float baseValue, float minVal, float maxVal)
+{
+    base[dst] = baseValue;
+    minValues[dst] = minVal;
+    maxValues[dst] = maxVal;
+}
+
+bool ModMatrix::setRoute(ModSource src, ModDestination dst, float depth, ModSource via, ModTaper taper)
+{
+    for(unsigned int r = 0; r < numRoutes; r++) {
+        if(routes[r].src != src || routes[r].dst != dst)
+            continue;
+        if(depth == 0.f) {
+            // keep the active routes packed
+            routes[r] = routes[--numRoutes];
+        } else {
+            routes[r].depth = depth;
+            routes[r].via = (unsigned char)via;
+            routes[r].taper = (unsigned char)taper;
+        }
+        return true;
+    }
+
+    if(depth == 0.f)
+        return true;
+    if(numRoutes >= MOD_MAX_ROUTES)
+        return false;
+
+    Route& route = routes[numRoutes++];
+    route.src = (unsigned char)src;
+    route.dst = (unsigned char)dst;
+    route.via = (unsigned char)via;
+    route.taper = (unsigned char)taper;
+    route.depth = depth;
+    return true;
+}
+
+static inline float applyTaper(float x, unsigned int taper)
+{
+    switch(taper) {
+        case MOD_TAPER_LOG:     return table_lookup(gTaperLog.v, TAPER_SIZE, x);
+        case MOD_TAPER_ANTILOG: return table_lookup(gTaperAntiLog.v, TAPER_SIZE, x);
+        default:                return x;
+    }
+}
+
+void ModMatrix::evaluate()
+{
+    for(unsigned int d = 0; d < MOD_DST_PADDED; d += 4)
+        vf4::load(base + d).store(values + d);
+
+    // four routes per step: gather, multiply in lanes, scatter-add
+    for(unsigned int r = 0; r < numRoutes; r += 4) {
+        float src[4] = { 0.f, 0.f, 0.f, 0.f };
+        float via[4] = { 0.f, 0.f, 0.f, 0.f };
+        float depth[4] = { 0.f, 0.f, 0.f, 0.f };
+        unsigned int lanes = numRoutes - r < 4 ? numRoutes - r : 4;
+        for(unsigned int k = 0; k < lanes; k++) {
+            const Route& route = routes[r + k];
+            src[k] = applyTaper(sources[route.src], route.taper);
+            via[k] = sources[route.via];
+            depth[k] = route.depth;
+        }
+
+        float amount[4];
+        (vf4::load(src) * vf4::load(via) * vf4::load(depth)).store(amount);
+        for(unsigned int k = 0; k < lanes; k++)
+            values[routes[r + k].dst] += amount[k];
+    }
+
+    for(unsigned int d = 0; d < MOD_DST_PADDED; d += 4) {
+        vf4 v = vf4::load(values + d);
+        v = vmin(vmax(v, vf4::load(minValues + d)), vf4::load(maxValues + d));
+        v.store(values + d);
+    }
+}
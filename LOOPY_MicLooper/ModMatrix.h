@@ -0,0 +1,82 @@
+#ifndef MOD_MATRIX_H
+#define MOD_MATRIX_H
+
+// Sparse modulation matrix, evaluated once per audio block.
+//
+// Every destination has a base value and a [min, max] range. Routes add
+// depth * taper(source) * via to a destination, where `via` is another
+// source scaling the route (e.g. a knob setting how much LFO reaches the
+// delay time). Only active routes are stored, packed at the front of a
+// small array, and they are evaluated four at a time in vf4 lanes; the
+// destinations are clamped the same way. A route with depth 0 is removed.
+
+#include "Simd.h"
+
+enum ModSource {
+    MOD_SRC_NONE = 0,   // constant 1: "no via"
+    MOD_SRC_LFO,        // bipolar [-1..1]
+    MOD_SRC_ENVELOPE,   // input envelope [0..1]
+    MOD_SRC_KNOB0,
+    MOD_SRC_KNOB1,
+    MOD_SRC_KNOB2,
+    MOD_SRC_KNOB3,
+    MOD_SRC_AUTO0,      // automation lanes, set by code
+    MOD_SRC_AUTO1,
+    MOD_NUM_SOURCES
+};
+
+enum ModDestination {
+    MOD_DST_DELAY_TIME = 0,  // seconds
+    MOD_DST_FEEDBACK,
+    MOD_DST_MIX,
+    MOD_DST_SPEED,           // playback speed, negative = reverse
+    MOD_DST_LFO_MORPH,       // MORPH shape position [0..3]
+    MOD_NUM_DESTINATIONS
+};
+
+enum ModTaper {
+    MOD_TAPER_LINEAR = 0,
+    MOD_TAPER_LOG,       // audio taper table, for sources in [0..1]
+    MOD_TAPER_ANTILOG
+};
+
+#define MOD_MAX_ROUTES 16
+#define MOD_DST_PADDED (((MOD_NUM_DESTINATIONS) + 3) & ~3)
+
+class ModMatrix {
+public:
+    ModMatrix();
+
+    void setRange(ModDestination dst, float base, float minVal, float maxVal);
+    // Add, update or (depth == 0) remove the route src -> dst
+    bool setRoute(ModSource src, ModDestination dst, float depth,
+                  ModSource via = MOD_SRC_NONE, ModTaper taper = MOD_TAPER_LINEAR);
+    void clearRoutes() { numRoutes = 0; }
+    unsigned int activeRoutes() const { return numRoutes; }
+
+    void setSource(ModSource src, float value) { sources[src] = value; }
+    float source(ModSource src) const { return sources[src]; }
+
+    void evaluate();
+    float get(ModDestination dst) const { return values[dst]; }
+
+private:
+    struct Route {
+        unsigned char src;
+        unsigned char dst;
+        unsigned char via;
+        unsigned char taper;
+        float depth;
+    };
+
+    Route routes[MOD_MAX_ROUTES];
+    unsigned int numRoutes;
+
+    float sources[MOD_NUM_SOURCES];
+    float base[MOD_DST_PADDED];
+    float minValues[MOD_DST_PADDED];
+    float maxValues[MOD_DST_PADDED];
+    float values[MOD_DST_PADDED];
+};
+
+#endif
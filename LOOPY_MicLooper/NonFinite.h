@@ -0,0 +1,49 @@
+#ifndef NON_FINITE_H
+#define NON_FINITE_H
+
+// Cheap guards against NaN/Inf getting stuck in feedback buffers. The bulk
+// check ORs vnonfinite() of everything together in vf4 lanes, an integer
+// test of the exponent bits that still holds under -ffast-math (which the
+// Bela build uses, and which lets the compiler assume NaN == NaN). Only
+// when it fails is the range scanned sample by sample to find where the
+// damage starts.
+
+#include "Simd.h"
+
+inline bool all_finite(const float* p, unsigned int n)
+{
+    vf4 acc(0.f);
+    unsigned int i = 0;
+    for(; i + 4 <= n; i += 4)
+        acc = acc | vnonfinite(vf4::load(p + i));
+    uint32_t bad = hor(acc);
+    for(; i < n; i++)
+        bad |= vnonfinite(p[i]);
+    return bad == 0;
+}
+
+inline bool is_finite(float x)
+{
+    return vnonfinite(x) == 0;
+}
+
+// Check ring[start .. start + count), wrapping at `size`. If a non-finite
+// value is found, everything from it to the end of the range is zeroed
+// (later writes were made from poisoned state) and true is returned.
+inline bool scrub_ring(float* ring, unsigned int size, unsigned int start, unsigned int count)
+{
+    if(count > size)
+        count = size;
+    unsigned int head = size - start < count ? size - start : count;
+    if(all_finite(ring + start, head) && all_finite(ring, count - head))
+        return false;
+
+    unsigned int k = 0;
+    while(k < count && is_finite(ring[(start + k) % size]))
+        k++;
+    for(; k < count; k++)
+        ring[(start + k) % size] = 0.f;
+    return true;
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include "Pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Cost smoothing, per timed block
+#define PIPELINE_COST_SMOOTHING 0.05f
+
+static double nowNs()
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------
+// BlockQueue
+
+BlockQueue::BlockQueue()
+    : blockSize(0)
+    , mask(0)
+    , head(0)
+    , tail(0)
+{
+}
+
+void BlockQueue::resize(unsigned int blocks, unsigned int size)
+{
+    unsigned int capacity = 1;
+    while(capacity < blocks)
+        capacity <<= 1;
+    storage.assign((size_t)capacity * size, 0.f);
+    blockSize = size;
+    mask = capacity - 1;
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+}
+
+float* BlockQueue::writeSlot()
+{
+    unsigned int h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) > mask)
+        return nullptr;
+    return &storage[(size_t)(h & mask) * blockSize];
+}
+
+void BlockQueue::push()
+{
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const float* BlockQueue::front()
+{
+    unsigned int t = tail.load(std::memory_order_relaxed);
+    if(head.load(std::memory_order_acquire) == t)
+        return nullptr;
+    return &storage[(size_t)(t & mask) * blockSize];
+}
+
+void BlockQueue::pop()
+{
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+unsigned int BlockQueue::available() const
+{
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+// ------------------------------------------------------
+// Pipeline
+
+Pipeline::Pipeline()
+    : running(false)
+    , blockSize(0)
+    , blockNs(0.f)
+    , latency(0)
+    , timingCounter(0)
+    , missed(0)
+    , dropped(0)
+{
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+void Pipeline::addStage(EffectStage* stage)
+{
+    if(running.load())
+        return;
+    // std::atomic is not movable: rebuild the vector
+    std::vector<Stage> grown(stages.size() + 1);
+    for(unsigned int i = 0; i < stages.size(); i++) {
+        grown[i].stage = stages[i].stage;
+        grown[i].worker = stages[i].worker;
+        grown[i].cost.store(stages[i].cost.load());
+    }
+    grown.back().stage = stage;
+    grown.back().worker = 0;
+    grown.back().cost.store(0.f);
+    stages.swap(grown);
+}
+
+void Pipeline::runStages(unsigned int first, unsigned int count, float* block, unsigned int n, bool timed)
+{
+    if(!timed) {
+        for(unsigned int i = first; i < first + count; i++)
+            stages[i].stage->process(block, n);
+        return;
+    }
+    double t0 = nowNs();
+    for(unsigned int i = first; i < first + count; i++) {
+        stages[i].stage->process(block, n);
+        double t1 = nowNs();
+        float cost = stages[i].cost.load(std::memory_order_relaxed);
+        cost = cost > 0.f ? cost + PIPELINE_COST_SMOOTHING * ((float)(t1 - t0) - cost) : (float)(t1 - t0);
+        stages[i].cost.store(cost, std::memory_order_relaxed);
+        t0 = t1;
+    }
+}
+
+// Contiguous groups minimising the most expensive one (linear partition)
+void Pipeline::balance(unsigned int workers)
+{
+    unsigned int s = numStages();
+    if(workers > s)
+        workers = s;
+    // by measured cost, or by count before anything was measured
+    bool measured = false;
+    for(unsigned int i = 0; i < s; i++)
+        measured = measured || stages[i].cost.load() > 0.f;
+    std::vector<double> prefix(s + 1, 0.0);
+    for(unsigned int i = 0; i < s; i++)
+        prefix[i + 1] = prefix[i] + (measured ? stages[i].cost.load() : 1.0);
+
+    // best[w][i]: smallest max group cost for the first i stages in w groups
+    std::vector<std::vector<double>> best(workers + 1, std::vector<double>(s + 1, 1e300));
+    std::vector<std::vector<unsigned int>> cut(workers + 1, std::vector<unsigned int>(s + 1, 0));
+    best[0][0] = 0.0;
+    for(unsigned int w = 1; w <= workers; w++)
+        for(unsigned int i = 1; i <= s; i++)
+            for(unsigned int j = w - 1; j < i; j++) {
+                double c = std::max(best[w - 1][j], prefix[i] - prefix[j]);
+                if(c < best[w][i]) {
+                    best[w][i] = c;
+                    cut[w][i] = j;
+                }
+            }
+
+    groups.assign(workers, Group());
+    unsigned int end = s;
+    for(unsigned int w = workers; w > 0; w--) {
+        unsigned int begin = cut[w][end];
+        groups[w - 1].first = begin;
+        groups[w - 1].count = end - begin;
+        for(unsigned int i = begin; i < end; i++)
+            stages[i].worker = w - 1;
+        end = begin;
+    }
+}
+
+bool Pipeline::start(unsigned int size, float sampleRate, unsigned int workers, unsigned int slackBlocks)
+{
+    stop();
+    blockSize = size;
+    blockNs = 1e9f * (float)size / sampleRate;
+    missed.store(0);
+    dropped.store(0);
+    groups.clear();
+    latency = 0;
+    if(workers == 0 || stages.empty())
+        return true;
+
+    balance(workers);
+
+    // the last queue starts with `latency` blocks of silence, so the audio
+    // thread finds a block there from the first call
+    latency = numWorkers() + slackBlocks;
+    std::vector<BlockQueue> q(numWorkers() + 1);
+    queues.swap(q);
+    for(auto& queue : queues)
+        queue.resize(latency + 2, size);
+    for(unsigned int k = 0; k < latency; k++) {
+        std::memset(queues.back().writeSlot(), 0, size * sizeof(float));
+        queues.back().push();
+    }
+
+    running.store(true);
+    for(unsigned int w = 0; w < numWorkers(); w++)
+        threads.emplace_back(&Pipeline::workerLoop, this, w);
+    return true;
+}
+
+void Pipeline::stop()
+{
+    running.store(false);
+    for(auto& t : threads)
+        t.join();
+    threads.clear();
+    // back to inline
+    groups.clear();
+    queues.clear();
+    latency = 0;
+    for(auto& stage : stages)
+        stage.worker = 0;
+}
+
+void Pipeline::workerLoop(unsigned int w)
+{
+    BlockQueue& in = queues[w];
+    BlockQueue& out = queues[w + 1];
+    unsigned int idle = 0;
+    while(running.load(std::memory_order_relaxed)) {
+        const float* src = in.front();
+        float* dst = src ? out.writeSlot() : nullptr;
+        if(!dst) {
+            // spin briefly, then give the core away
+            if(++idle < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+        idle = 0;
+        std::memcpy(dst, src, blockSize * sizeof(float));
+        in.pop();
+        runStages(groups[w].first, groups[w].count, dst, blockSize, true);
+        out.push();
+    }
+}
+
+void Pipeline::process(float* block, unsigned int n)
+{
+    if(groups.empty()) {
+        bool timed = ++timingCounter >= PIPELINE_TIMING_INTERVAL;
+        if(timed)
+            timingCounter = 0;
+        runStages(0, numStages(), block, n, timed);
+        return;
+    }
+
+    // queue slots hold blockSize samples
+    if(n > blockSize) {
+        std::memset(block, 0, n * sizeof(float));
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    float* slot = queues.front().writeSlot();
+    if(slot) {
+        std::memcpy(slot, block, n * sizeof(float));
+        queues.front().push();
+    } else {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const float* result = queues.back().front();
+    if(result) {
+        std::memcpy(block, result, n * sizeof(float));
+        queues.back().pop();
+    } else {
+        std::memset(block, 0, n * sizeof(float));
+        missed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool Pipeline::ready()
+{
+    if(groups.empty())
+        return true;
+    return queues.front().writeSlot() != nullptr && queues.back().front() != nullptr;
+}
+
+float Pipeline::workerLoad(unsigned int w) const
+{
+    float busy = 0.f;
+    for(unsigned int i = groups[w].first; i < groups[w].first + groups[w].count; i++)
+        busy += stages[i].cost.load(std::memory_order_relaxed);
+    return blockNs > 0.f ? busy / blockNs : 0.f;
+}
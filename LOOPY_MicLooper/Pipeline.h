@@ -0,0 +1,120 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+// An effect chain that runs block by block, either inline or pipelined
+// across worker threads on multi-core hosts (the Bela has one core: leave
+// it inline there).
+//
+// Pipelined, the stages are split into contiguous groups of about equal
+// cost, one per worker, connected by single-producer/consumer queues of
+// blocks. The audio thread only copies its block into the first queue and
+// takes the block that left the last one, which is `workers` blocks old
+// (plus any slack): throughput scales with the number of workers as long
+// as the stages split evenly, for that much latency.
+//
+// The split uses the stage costs measured while running inline (one block
+// in PIPELINE_TIMING_INTERVAL is timed), so it is only as good as what ran
+// before start(); stop() and start() again to re-split. The cost of every
+// stage and the load of every worker are measured as it runs and can be
+// read from any thread.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Inline, one block in this many is timed
+#define PIPELINE_TIMING_INTERVAL 64
+
+// A block effect. process() must not allocate or block.
+class EffectStage {
+public:
+    virtual ~EffectStage() {}
+    virtual void process(float* block, unsigned int n) = 0;
+    virtual const char* name() const = 0;
+};
+
+// Lock-free queue of fixed-size blocks, one producer and one consumer
+class BlockQueue {
+public:
+    BlockQueue();
+
+    void resize(unsigned int blocks, unsigned int blockSize);
+    float* writeSlot();          // producer: next free block, or nullptr
+    void push();
+    const float* front();        // consumer: oldest block, or nullptr
+    void pop();
+    unsigned int available() const;
+
+private:
+    std::vector<float> storage;
+    unsigned int blockSize;
+    unsigned int mask;
+    std::atomic<unsigned int> head;     // written by the producer
+    std::atomic<unsigned int> tail;     // written by the consumer
+};
+
+class Pipeline {
+public:
+    Pipeline();
+    ~Pipeline();
+
+    // Setup, while stopped. The pipeline does not own its stages.
+    void addStage(EffectStage* stage);
+    // workers == 0 runs inline. Otherwise the stages are split into up to
+    // `workers` groups by the costs measured so far (by count if none) and
+    // the threads started; output is delayed by latencyBlocks(). Blocks in
+    // flight when stopped are lost, and process() runs inline again. Not
+    // real-time safe.
+    bool start(unsigned int blockSize, float sampleRate, unsigned int workers, unsigned int slackBlocks = 1);
+    void stop();
+
+    // ---- audio thread
+    // Pipelined, n must be at most start()'s blockSize: a longer block is
+    // not queued but returned silent and counted as an overrun.
+    void process(float* block, unsigned int n);
+    // Offline rendering: true when process() would neither drop the input
+    // nor return silence
+    bool ready();
+
+    // ---- any thread
+    unsigned int numStages() const { return (unsigned int)stages.size(); }
+    unsigned int numWorkers() const { return (unsigned int)groups.size(); }
+    unsigned int latencyBlocks() const { return latency; }
+    const char* stageName(unsigned int i) const { return stages[i].stage->name(); }
+    unsigned int stageWorker(unsigned int i) const { return stages[i].worker; }
+    // Mean time per block, in ns
+    float stageCost(unsigned int i) const { return stages[i].cost.load(std::memory_order_relaxed); }
+    // Busy time over the block period; above 1 the worker cannot keep up
+    float workerLoad(unsigned int w) const;
+    unsigned int underruns() const { return missed.load(std::memory_order_relaxed); }
+    unsigned int overruns() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Stage {
+        EffectStage* stage;
+        unsigned int worker;
+        std::atomic<float> cost;
+    };
+    struct Group {
+        unsigned int first;
+        unsigned int count;
+    };
+
+    void runStages(unsigned int first, unsigned int count, float* block, unsigned int n, bool timed);
+    void balance(unsigned int workers);
+    void workerLoop(unsigned int w);
+
+    std::vector<Stage> stages;
+    std::vector<Group> groups;
+    std::vector<BlockQueue> queues;     // groups + 1
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    unsigned int blockSize;
+    float blockNs;
+    unsigned int latency;
+    unsigned int timingCounter;
+    std::atomic<unsigned int> missed;
+    std::atomic<unsigned int> dropped;
+};
+
+#endif
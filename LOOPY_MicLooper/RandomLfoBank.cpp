@@ -0,0 +1,73 @@
+#include "RandomLfoBank.h"
+
+RandomLfoBank::RandomLfoBank(float sr)
+    : sampleRate(sr)
+    , shape(SMOOTH_RANDOM)
+    , phase(0.f)
+    , increment(0.f)
+    , walk(0.25f)
+{
+    for(unsigned int lane = 0; lane < 4; lane++)
+        increments[lane] = 0.f;
+    seed(1);
+}
+
+void RandomLfoBank::seed(uint32_t seed)
+{
+    uint32_t states[4];
+    for(unsigned int lane = 0; lane < 4; lane++)
+        states[lane] = vrandom_seed(seed, lane);
+    rng = vrandom_state(states);
+    prev = vrandom(rng);
+    next = vrandom(rng);
+    phase = 0.f;
+}
+
+void RandomLfoBank::setRate(unsigned int lane, float hz)
+{
+    increments[lane & 3] = hz / sampleRate;
+    increment = vf4::load(increments);
+}
+
+void RandomLfoBank::setWalk(float step)
+{
+    walk = vmin(vmax(vf4(step), vf4(0.f)), vf4(1.f));
+}
+
+vf4 RandomLfoBank::process()
+{
+    vf4 one(1.f);
+    vf4 r = vrandom(rng);
+    if(shape == DRUNK) {
+        // step from the current target, reflecting off 0 and 1
+        r = vabs(next + walk * (r + r - one));
+        r = one - vabs(one - r);
+    }
+
+    vf4 out;
+    if(shape == SAMPLE_HOLD) {
+        out = next;
+    } else {
+        vf4 s = phase * phase * (vf4(3.f) - phase - phase);
+        out = prev + s * (next - prev);
+    }
+
+    phase = phase + increment;
+    vf4 wrapped = phase >= one;
+    phase = phase - (wrapped & one);
+    prev = vselect(wrapped, next, prev);
+    next = vselect(wrapped, r, next);
+    return out;
+}
+
+void RandomLfoBank::processBlock(float* const out[4], unsigned int n)
+{
+    float v[4];
+    for(unsigned int i = 0; i < n; i++) {
+        process().store(v);
+        out[0][i] = v[0];
+        out[1][i] = v[1];
+        out[2][i] = v[2];
+        out[3][i] = v[3];
+    }
+}
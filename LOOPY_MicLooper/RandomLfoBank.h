@@ -0,0 +1,42 @@
+#ifndef RANDOM_LFO_BANK_H
+#define RANDOM_LFO_BANK_H
+
+// Four random LFOs side by side, one per vf4 lane, each with its own rate
+// and its own xorshift32 generator. Shapes are the random ones from lfo.h
+// (SAMPLE_HOLD, SMOOTH_RANDOM, DRUNK) and behave the same way: a new level
+// is drawn whenever a lane's phase wraps. The generators step every tick
+// in all lanes, which is cheaper in vectors than branching per lane, so a
+// lane's sequence depends on its seed and rate but not on the other lanes.
+
+#include <stdint.h>
+#include "Simd.h"
+#include "lfo.h"
+
+class RandomLfoBank {
+public:
+    RandomLfoBank(float sampleRate);
+
+    void seed(uint32_t seed);
+    void setRate(unsigned int lane, float hz);
+    void setShape(unsigned int type) { shape = type; }
+    void setWalk(float step);  // drunk walk: max step per cycle, all lanes
+
+    // One tick for all four lanes, values in [0..1]
+    vf4 process();
+    // n ticks; out[lane][i]
+    void processBlock(float* const out[4], unsigned int n);
+
+private:
+    float sampleRate;
+    unsigned int shape;
+    float increments[4];
+
+    vf4 phase;
+    vf4 increment;
+    vf4 prev;
+    vf4 next;
+    vf4 walk;
+    vf4 rng;
+};
+
+#endif
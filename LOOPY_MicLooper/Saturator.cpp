@@ -0,0 +1,137 @@
+#include "Saturator.h"
+#include "FastMath.h"
+#include "Tables.h"
+
+// ------------------------------------------------------
+// Half-band filters
+
+template <unsigned int N>
+SIMD_INLINE float dotTaps(const float* x, const float* taps)
+{
+    vf4 acc = vf4::load(x) * vf4::load(taps);
+    for(unsigned int k = 4; k < N; k += 4)
+        acc = acc + vf4::load(x + k) * vf4::load(taps + k);
+    return hsum(acc);
+}
+
+template <unsigned int N>
+void HalfbandUp<N>::reset()
+{
+    for(unsigned int i = 0; i < 2 * N; i++)
+        history[i] = 0.f;
+    pos = 0;
+}
+
+// history[pos + j] is the input j samples back. The even output is the
+// input N/2 back, the odd one the point half a sample after it.
+template <unsigned int N>
+SIMD_INLINE void HalfbandUp<N>::process(float x, float& first, float& second)
+{
+    pos = pos ? pos - 1 : N - 1;
+    history[pos] = history[pos + N] = x;
+    first = history[pos + N / 2];
+    second = dotTaps<N>(history + pos, taps);
+}
+
+template <unsigned int N>
+void HalfbandDown<N>::reset()
+{
+    for(unsigned int i = 0; i < 2 * N; i++)
+        even[i] = odd[i] = 0.f;
+    pos = 0;
+}
+
+// Centred on the even sample N/2 - 1 pairs back, with the odd samples
+// symmetric around it: a half-band FIR at the high rate, keeping every
+// other output.
+template <unsigned int N>
+SIMD_INLINE float HalfbandDown<N>::process(float first, float second)
+{
+    pos = pos ? pos - 1 : N - 1;
+    even[pos] = even[pos + N] = first;
+    odd[pos] = odd[pos + N] = second;
+    return 0.5f * (even[pos + N / 2 - 1] + dotTaps<N>(odd + pos, taps));
+}
+
+// ------------------------------------------------------
+// Saturator
+
+Saturator::Saturator()
+    : factor(2)
+    , ceiling(1.f)
+    , invCeiling(1.f)
+{
+    up2.taps = down2.taps = gHalfbandLong.v;
+    up4.taps = down4.taps = gHalfbandShort.v;
+    reset();
+}
+
+void Saturator::setOversampling(unsigned int f)
+{
+    unsigned int newFactor = f >= 4 ? 4 : (f >= 2 ? 2 : 1);
+    if(newFactor != factor)
+        reset();
+    factor = newFactor;
+}
+
+void Saturator::setCeiling(float ceilingLevel)
+{
+    ceiling = ceilingLevel > 1e-3f ? ceilingLevel : 1e-3f;
+    invCeiling = 1.f / ceiling;
+}
+
+void Saturator::reset()
+{
+    up2.reset();
+    down2.reset();
+    up4.reset();
+    down4.reset();
+    pending = 0.f;
+}
+
+float Saturator::latency() const
+{
+    // each 2x stage delays by N/2 going up and N/2 - 1 coming down, at its
+    // low rate. The inner stage's N - 1 is odd at 2x, which would hand the
+    // outer decimator its phases swapped, so one more 2x sample is added.
+    float lag = 0.f;
+    if(factor >= 2)
+        lag += HALFBAND_LONG - 1;
+    if(factor >= 4)
+        lag += 0.5f * HALFBAND_SHORT;
+    return lag;
+}
+
+float Saturator::processSample(float x)
+{
+    float a, b;
+    switch(factor) {
+        case 1:
+            return ceiling * fast_tanh(x * invCeiling);
+
+        case 2: {
+            up2.process(x, a, b);
+            float v[4] = { a, b, 0.f, 0.f };
+            (vf4(ceiling) * fast_tanh(vf4::load(v) * vf4(invCeiling))).store(v);
+            return down2.process(v[0], v[1]);
+        }
+
+        default: {
+            up2.process(x, a, b);
+            float v[4];
+            up4.process(a, v[0], v[1]);
+            up4.process(b, v[2], v[3]);
+            (vf4(ceiling) * fast_tanh(vf4::load(v) * vf4(invCeiling))).store(v);
+            float first = pending;
+            float second = down4.process(v[0], v[1]);
+            pending = down4.process(v[2], v[3]);
+            return down2.process(first, second);
+        }
+    }
+}
+
+void Saturator::processBlock(float* buf, unsigned int n)
+{
+    for(unsigned int i = 0; i < n; i++)
+        buf[i] = processSample(buf[i]);
+}
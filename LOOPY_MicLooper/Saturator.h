@@ -0,0 +1,68 @@
+#ifndef SATURATOR_H
+#define SATURATOR_H
+
+// Tape-style soft saturation, ceiling * tanh(x / ceiling), run at 1x, 2x
+// or 4x the sample rate so the harmonics it creates above Nyquist are
+// filtered out instead of aliasing back down. Resampling uses polyphase
+// half-band filters (Tables.h): only the odd branch is a real FIR, evaluated
+// as vf4 dot products, and the even branch is a plain delay. At 4x the
+// four oversampled values of one input sample go through a single vf4
+// fast_tanh.
+
+#include "Simd.h"
+#include "Tables.h"
+
+// Half-band 1 -> 2 interpolator with N odd-branch taps (a multiple of 4)
+template <unsigned int N>
+struct HalfbandUp {
+    const float* taps;
+    float history[2 * N];   // doubled, so the newest N are always contiguous
+    unsigned int pos;
+
+    void reset();
+    // Push one sample, get two back in time order
+    SIMD_INLINE void process(float x, float& first, float& second);
+};
+
+// Half-band 2 -> 1 decimator with N odd-branch taps (a multiple of 4)
+template <unsigned int N>
+struct HalfbandDown {
+    const float* taps;
+    float even[2 * N];
+    float odd[2 * N];
+    unsigned int pos;
+
+    void reset();
+    // Push two samples in time order, get one back
+    SIMD_INLINE float process(float first, float second);
+};
+
+class Saturator {
+public:
+    Saturator();
+
+    void setOversampling(unsigned int factor); // 1, 2 or 4
+    unsigned int oversampling() const { return factor; }
+    void setCeiling(float ceilingLevel);
+
+    float processSample(float x);
+    void processBlock(float* buf, unsigned int n);
+
+    // Group delay of the resampling filters, in base-rate samples
+    float latency() const;
+    void reset();
+
+private:
+    unsigned int factor;
+    float ceiling;
+    float invCeiling;
+
+    HalfbandUp<HALFBAND_LONG> up2;     // 1x <-> 2x
+    HalfbandDown<HALFBAND_LONG> down2;
+    HalfbandUp<HALFBAND_SHORT> up4;    // 2x <-> 4x: what aliases at 4x folds at the
+                                       // shaper, so longer filters gain nothing
+    HalfbandDown<HALFBAND_SHORT> down4;
+    float pending;           // odd 2x sample held over to realign, see latency()
+};
+
+#endif
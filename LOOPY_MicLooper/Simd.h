@@ -0,0 +1,558 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin wrappers over the vector units we build for:
+//   - NEON on the Bela (Cortex-A8, ARMv7: no vector divide, no vrndm)
+//   - SSE2 (SSE4.1 when available) on x86 hosts
+//   - AVX2 on x86 hosts, as an additional 8-lane type
+//   - plain scalar code everywhere else
+// vf4 is always available and always 4 lanes wide. Comparisons return
+// lane masks of the same type (all bits set where true) for vselect().
+// The same free functions are overloaded for float, so DSP templates can
+// be written once and instantiated for scalar and vector code.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LOOPY_SIMD_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#define LOOPY_SIMD_SSE 1
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LOOPY_SIMD_AVX2 1
+#endif
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+// ------------------------------------------------------
+// Scalar overloads
+
+SIMD_INLINE float vselect(bool mask, float a, float b) { return mask ? a : b; }
+SIMD_INLINE float vmin(float a, float b) { return a < b ? a : b; }
+SIMD_INLINE float vmax(float a, float b) { return a > b ? a : b; }
+SIMD_INLINE float vabs(float a) { return a < 0.f ? -a : a; }
+SIMD_INLINE float vrecip(float a) { return 1.f / a; }
+
+// floor for |x| < 2^31, without the libm call the Cortex-A8 VFP needs
+SIMD_INLINE float vfloor(float x)
+{
+    int i = (int)x;
+    return (float)(i - (x < (float)i));
+}
+
+// 2^n for integral n in [-126, 127]
+SIMD_INLINE float vpow2i(float n)
+{
+    int32_t bits = ((int32_t)n + 127) << 23;
+    float r;
+    std::memcpy(&r, &bits, sizeof(r));
+    return r;
+}
+
+// x = mantissa * 2^exponent, mantissa in [0.5, 1), for positive normal x
+SIMD_INLINE float vexponent(float x)
+{
+    int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (float)(((bits >> 23) & 0xff) - 126);
+}
+
+SIMD_INLINE float vmantissa(float x)
+{
+    int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    bits = (bits & 0x807fffff) | 0x3f000000;
+    float r;
+    std::memcpy(&r, &bits, sizeof(r));
+    return r;
+}
+
+// xorshift32 step; returns a uniform float in [0, 1). state must be non-zero.
+SIMD_INLINE float vrandom(uint32_t& state)
+{
+    uint32_t x = state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state = x;
+    uint32_t bits = (x >> 9) | 0x3f800000u;
+    float r;
+    std::memcpy(&r, &bits, sizeof(r));
+    return r - 1.f;
+}
+
+// Non-zero, well separated vrandom() state for generator `stream` of `seed`
+SIMD_INLINE uint32_t vrandom_seed(uint32_t seed, uint32_t stream)
+{
+    uint32_t x = seed + stream * 0x9e3779b9u;
+    x = (x ^ (x >> 16)) * 0x85ebca6bu;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x ? x : 0x6d2b79f5u;
+}
+
+// Lossless codec residual (LoopCodec.h): x and prev as order-preserving
+// integers of their bits, x minus prev, zigzagged so that small steps
+// either way become small unsigned values
+SIMD_INLINE uint32_t vresidual(float x, float prev)
+{
+    int32_t a, b;
+    std::memcpy(&a, &x, sizeof(a));
+    std::memcpy(&b, &prev, sizeof(b));
+    a ^= (int32_t)((uint32_t)(a >> 31) >> 1);
+    b ^= (int32_t)((uint32_t)(b >> 31) >> 1);
+    uint32_t d = (uint32_t)a - (uint32_t)b;
+    return (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+}
+
+// Bit 31 set if x is NaN or Inf, else 0. Tested on the exponent bits as
+// integers (all ones carries into bit 31), so -ffast-math and
+// -ffinite-math-only cannot fold it away the way they can x != x
+SIMD_INLINE uint32_t vnonfinite(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return ((bits & 0x7f800000u) + 0x00800000u) & 0x80000000u;
+}
+
+// ------------------------------------------------------
+// vf4: four float lanes
+
+#if LOOPY_SIMD_NEON
+
+struct vf4 {
+    float32x4_t v;
+    SIMD_INLINE vf4() {}
+    SIMD_INLINE vf4(float32x4_t x) : v(x) {}
+    SIMD_INLINE vf4(float x) : v(vdupq_n_f32(x)) {}
+    static SIMD_INLINE vf4 load(const float* p) { return vld1q_f32(p); }
+    SIMD_INLINE void store(float* p) const { vst1q_f32(p, v); }
+};
+
+SIMD_INLINE vf4 operator+(vf4 a, vf4 b) { return vaddq_f32(a.v, b.v); }
+SIMD_INLINE vf4 operator-(vf4 a, vf4 b) { return vsubq_f32(a.v, b.v); }
+SIMD_INLINE vf4 operator*(vf4 a, vf4 b) { return vmulq_f32(a.v, b.v); }
+SIMD_INLINE vf4 operator-(vf4 a) { return vnegq_f32(a.v); }
+SIMD_INLINE vf4 operator<(vf4 a, vf4 b) { return vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)); }
+SIMD_INLINE vf4 operator>(vf4 a, vf4 b) { return vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)); }
+SIMD_INLINE vf4 operator<=(vf4 a, vf4 b) { return vreinterpretq_f32_u32(vcleq_f32(a.v, b.v)); }
+SIMD_INLINE vf4 operator>=(vf4 a, vf4 b) { return vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v)); }
+SIMD_INLINE vf4 operator&(vf4 a, vf4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))); }
+SIMD_INLINE vf4 operator|(vf4 a, vf4 b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))); }
+SIMD_INLINE vf4 vselect(vf4 mask, vf4 a, vf4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v); }
+SIMD_INLINE vf4 vmin(vf4 a, vf4 b) { return vminq_f32(a.v, b.v); }
+SIMD_INLINE vf4 vmax(vf4 a, vf4 b) { return vmaxq_f32(a.v, b.v); }
+SIMD_INLINE vf4 vabs(vf4 a) { return vabsq_f32(a.v); }
+
+// no vector divide on ARMv7: estimate plus two Newton-Raphson steps
+SIMD_INLINE vf4 vrecip(vf4 a)
+{
+    float32x4_t r = vrecpeq_f32(a.v);
+    r = vmulq_f32(r, vrecpsq_f32(a.v, r));
+    r = vmulq_f32(r, vrecpsq_f32(a.v, r));
+    return r;
+}
+
+SIMD_INLINE vf4 vfloor(vf4 x)
+{
+    float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(x.v));
+    uint32x4_t gt = vcgtq_f32(t, x.v);
+    return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(gt, vreinterpretq_u32_f32(vdupq_n_f32(1.f)))));
+}
+
+SIMD_INLINE vf4 vpow2i(vf4 n)
+{
+    int32x4_t i = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n.v), vdupq_n_s32(127)), 23);
+    return vreinterpretq_f32_s32(i);
+}
+
+SIMD_INLINE vf4 vexponent(vf4 x)
+{
+    int32x4_t i = vreinterpretq_s32_f32(x.v);
+    i = vsubq_s32(vandq_s32(vshrq_n_s32(i, 23), vdupq_n_s32(0xff)), vdupq_n_s32(126));
+    return vcvtq_f32_s32(i);
+}
+
+SIMD_INLINE vf4 vmantissa(vf4 x)
+{
+    int32x4_t i = vreinterpretq_s32_f32(x.v);
+    i = vorrq_s32(vandq_s32(i, vdupq_n_s32((int32_t)0x807fffff)), vdupq_n_s32(0x3f000000));
+    return vreinterpretq_f32_s32(i);
+}
+
+// [x, a0, a1, a2]: shift one new sample into lane 0
+SIMD_INLINE vf4 vshift_in(vf4 a, float x) { return vextq_f32(vdupq_n_f32(x), a.v, 3); }
+
+// Four independent xorshift32 generators; `state` holds their raw bits
+SIMD_INLINE vf4 vrandom(vf4& state)
+{
+    uint32x4_t x = vreinterpretq_u32_f32(state.v);
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    x = veorq_u32(x, vshlq_n_u32(x, 5));
+    state = vreinterpretq_f32_u32(x);
+    uint32x4_t bits = vorrq_u32(vshrq_n_u32(x, 9), vdupq_n_u32(0x3f800000u));
+    return vsubq_f32(vreinterpretq_f32_u32(bits), vdupq_n_f32(1.f));
+}
+
+// vresidual() per lane; the result holds raw bits
+SIMD_INLINE vf4 vresidual(vf4 x, vf4 prev)
+{
+    int32x4_t a = vreinterpretq_s32_f32(x.v);
+    int32x4_t b = vreinterpretq_s32_f32(prev.v);
+    a = veorq_s32(a, vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(a, 31)), 1)));
+    b = veorq_s32(b, vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(b, 31)), 1)));
+    int32x4_t d = vsubq_s32(a, b);
+    return vreinterpretq_f32_s32(veorq_s32(vshlq_n_s32(d, 1), vshrq_n_s32(d, 31)));
+}
+
+// vnonfinite() per lane; the result holds raw bits
+SIMD_INLINE vf4 vnonfinite(vf4 x)
+{
+    uint32x4_t i = vandq_u32(vreinterpretq_u32_f32(x.v), vdupq_n_u32(0x7f800000u));
+    i = vandq_u32(vaddq_u32(i, vdupq_n_u32(0x00800000u)), vdupq_n_u32(0x80000000u));
+    return vreinterpretq_f32_u32(i);
+}
+
+SIMD_INLINE float hsum(vf4 a)
+{
+    float32x2_t s = vadd_f32(vget_low_f32(a.v), vget_high_f32(a.v));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+SIMD_INLINE float hmax(vf4 a)
+{
+    float32x2_t m = vmax_f32(vget_low_f32(a.v), vget_high_f32(a.v));
+    return vget_lane_f32(vpmax_f32(m, m), 0);
+}
+
+// The lanes' bits ORed together, for masks and vnonfinite()
+SIMD_INLINE uint32_t hor(vf4 a)
+{
+    uint32x4_t u = vreinterpretq_u32_f32(a.v);
+    uint32x2_t o = vorr_u32(vget_low_u32(u), vget_high_u32(u));
+    return vget_lane_u32(o, 0) | vget_lane_u32(o, 1);
+}
+
+#elif LOOPY_SIMD_SSE
+
+struct vf4 {
+    __m128 v;
+    SIMD_INLINE vf4() {}
+    SIMD_INLINE vf4(__m128 x) : v(x) {}
+    SIMD_INLINE vf4(float x) : v(_mm_set1_ps(x)) {}
+    static SIMD_INLINE vf4 load(const float* p) { return _mm_loadu_ps(p); }
+    SIMD_INLINE void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+SIMD_INLINE vf4 operator+(vf4 a, vf4 b) { return _mm_add_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator-(vf4 a, vf4 b) { return _mm_sub_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator*(vf4 a, vf4 b) { return _mm_mul_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator-(vf4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.f)); }
+SIMD_INLINE vf4 operator<(vf4 a, vf4 b) { return _mm_cmplt_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator>(vf4 a, vf4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator<=(vf4 a, vf4 b) { return _mm_cmple_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator>=(vf4 a, vf4 b) { return _mm_cmpge_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator&(vf4 a, vf4 b) { return _mm_and_ps(a.v, b.v); }
+SIMD_INLINE vf4 operator|(vf4 a, vf4 b) { return _mm_or_ps(a.v, b.v); }
+SIMD_INLINE vf4 vselect(vf4 mask, vf4 a, vf4 b)
+{
+#if defined(__SSE4_1__)
+    return _mm_blendv_ps(b.v, a.v, mask.v);
+#else
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+#endif
+}
+SIMD_INLINE vf4 vmin(vf4 a, vf4 b) { return _mm_min_ps(a.v, b.v); }
+SIMD_INLINE vf4 vmax(vf4 a, vf4 b) { return _mm_max_ps(a.v, b.v); }
+SIMD_INLINE vf4 vabs(vf4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+SIMD_INLINE vf4 vrecip(vf4 a) { return _mm_div_ps(_mm_set1_ps(1.f), a.v); }
+
+SIMD_INLINE vf4 vfloor(vf4 x)
+{
+#if defined(__SSE4_1__)
+    return _mm_floor_ps(x.v);
+#else
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x.v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x.v), _mm_set1_ps(1.f)));
+#endif
+}
+
+SIMD_INLINE vf4 vpow2i(vf4 n)
+{
+    __m128i i = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n.v), _mm_set1_epi32(127)), 23);
+    return _mm_castsi128_ps(i);
+}
+
+SIMD_INLINE vf4 vexponent(vf4 x)
+{
+    __m128i i = _mm_srli_epi32(_mm_castps_si128(x.v), 23);
+    i = _mm_sub_epi32(_mm_and_si128(i, _mm_set1_epi32(0xff)), _mm_set1_epi32(126));
+    return _mm_cvtepi32_ps(i);
+}
+
+SIMD_INLINE vf4 vmantissa(vf4 x)
+{
+    __m128i i = _mm_castps_si128(x.v);
+    i = _mm_or_si128(_mm_and_si128(i, _mm_set1_epi32((int32_t)0x807fffff)), _mm_set1_epi32(0x3f000000));
+    return _mm_castsi128_ps(i);
+}
+
+// [x, a0, a1, a2]: shift one new sample into lane 0
+SIMD_INLINE vf4 vshift_in(vf4 a, float x)
+{
+    return _mm_move_ss(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 1, 0, 0)), _mm_set_ss(x));
+}
+
+// Four independent xorshift32 generators; `state` holds their raw bits
+SIMD_INLINE vf4 vrandom(vf4& state)
+{
+    __m128i x = _mm_castps_si128(state.v);
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    state = _mm_castsi128_ps(x);
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.f));
+}
+
+SIMD_INLINE vf4 vresidual(vf4 x, vf4 prev)
+{
+    __m128i a = _mm_castps_si128(x.v);
+    __m128i b = _mm_castps_si128(prev.v);
+    a = _mm_xor_si128(a, _mm_srli_epi32(_mm_srai_epi32(a, 31), 1));
+    b = _mm_xor_si128(b, _mm_srli_epi32(_mm_srai_epi32(b, 31), 1));
+    __m128i d = _mm_sub_epi32(a, b);
+    return _mm_castsi128_ps(_mm_xor_si128(_mm_slli_epi32(d, 1), _mm_srai_epi32(d, 31)));
+}
+
+SIMD_INLINE vf4 vnonfinite(vf4 x)
+{
+    __m128i i = _mm_and_si128(_mm_castps_si128(x.v), _mm_set1_epi32(0x7f800000));
+    i = _mm_and_si128(_mm_add_epi32(i, _mm_set1_epi32(0x00800000)), _mm_set1_epi32((int32_t)0x80000000u));
+    return _mm_castsi128_ps(i);
+}
+
+SIMD_INLINE float hsum(vf4 a)
+{
+    __m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+SIMD_INLINE float hmax(vf4 a)
+{
+    __m128 m = _mm_max_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+SIMD_INLINE uint32_t hor(vf4 a)
+{
+    __m128i u = _mm_castps_si128(a.v);
+    u = _mm_or_si128(u, _mm_shuffle_epi32(u, _MM_SHUFFLE(1, 0, 3, 2)));
+    u = _mm_or_si128(u, _mm_shuffle_epi32(u, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(u);
+}
+
+#else
+
+// Portable fallback: four scalar lanes, masks stored as raw bit patterns
+struct vf4 {
+    float v[4];
+    SIMD_INLINE vf4() {}
+    SIMD_INLINE vf4(float x) { v[0] = v[1] = v[2] = v[3] = x; }
+    static SIMD_INLINE vf4 load(const float* p) { vf4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+    SIMD_INLINE void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+};
+
+#define VF4_LANEWISE(expr) vf4 r; for(int i = 0; i < 4; i++) r.v[i] = (expr); return r
+
+SIMD_INLINE float vf4_mask(bool m)
+{
+    uint32_t bits = m ? 0xffffffffu : 0u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+SIMD_INLINE bool vf4_bit(float m)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &m, sizeof(bits));
+    return bits != 0;
+}
+
+SIMD_INLINE float vf4_bits(float a, float b, bool orOp)
+{
+    uint32_t x, y;
+    std::memcpy(&x, &a, sizeof(x));
+    std::memcpy(&y, &b, sizeof(y));
+    x = orOp ? (x | y) : (x & y);
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+SIMD_INLINE vf4 operator+(vf4 a, vf4 b) { VF4_LANEWISE(a.v[i] + b.v[i]); }
+SIMD_INLINE vf4 operator-(vf4 a, vf4 b) { VF4_LANEWISE(a.v[i] - b.v[i]); }
+SIMD_INLINE vf4 operator*(vf4 a, vf4 b) { VF4_LANEWISE(a.v[i] * b.v[i]); }
+SIMD_INLINE vf4 operator-(vf4 a) { VF4_LANEWISE(-a.v[i]); }
+SIMD_INLINE vf4 operator<(vf4 a, vf4 b) { VF4_LANEWISE(vf4_mask(a.v[i] < b.v[i])); }
+SIMD_INLINE vf4 operator>(vf4 a, vf4 b) { VF4_LANEWISE(vf4_mask(a.v[i] > b.v[i])); }
+SIMD_INLINE vf4 operator<=(vf4 a, vf4 b) { VF4_LANEWISE(vf4_mask(a.v[i] <= b.v[i])); }
+SIMD_INLINE vf4 operator>=(vf4 a, vf4 b) { VF4_LANEWISE(vf4_mask(a.v[i] >= b.v[i])); }
+SIMD_INLINE vf4 operator&(vf4 a, vf4 b) { VF4_LANEWISE(vf4_bits(a.v[i], b.v[i], false)); }
+SIMD_INLINE vf4 operator|(vf4 a, vf4 b) { VF4_LANEWISE(vf4_bits(a.v[i], b.v[i], true)); }
+SIMD_INLINE vf4 vselect(vf4 mask, vf4 a, vf4 b) { VF4_LANEWISE(vf4_bit(mask.v[i]) ? a.v[i] : b.v[i]); }
+SIMD_INLINE vf4 vmin(vf4 a, vf4 b) { VF4_LANEWISE(vmin(a.v[i], b.v[i])); }
+SIMD_INLINE vf4 vmax(vf4 a, vf4 b) { VF4_LANEWISE(vmax(a.v[i], b.v[i])); }
+SIMD_INLINE vf4 vabs(vf4 a) { VF4_LANEWISE(vabs(a.v[i])); }
+SIMD_INLINE vf4 vrecip(vf4 a) { VF4_LANEWISE(1.f / a.v[i]); }
+SIMD_INLINE vf4 vfloor(vf4 x) { VF4_LANEWISE(vfloor(x.v[i])); }
+SIMD_INLINE vf4 vpow2i(vf4 n) { VF4_LANEWISE(vpow2i(n.v[i])); }
+SIMD_INLINE vf4 vexponent(vf4 x) { VF4_LANEWISE(vexponent(x.v[i])); }
+SIMD_INLINE vf4 vmantissa(vf4 x) { VF4_LANEWISE(vmantissa(x.v[i])); }
+SIMD_INLINE vf4 vshift_in(vf4 a, float x) { vf4 r; r.v[0] = x; r.v[1] = a.v[0]; r.v[2] = a.v[1]; r.v[3] = a.v[2]; return r; }
+SIMD_INLINE float hsum(vf4 a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+
+SIMD_INLINE vf4 vrandom(vf4& state)
+{
+    vf4 r;
+    for(int i = 0; i < 4; i++) {
+        uint32_t x;
+        std::memcpy(&x, &state.v[i], sizeof(x));
+        r.v[i] = vrandom(x);
+        std::memcpy(&state.v[i], &x, sizeof(x));
+    }
+    return r;
+}
+SIMD_INLINE float hmax(vf4 a) { return vmax(vmax(a.v[0], a.v[1]), vmax(a.v[2], a.v[3])); }
+
+SIMD_INLINE vf4 vresidual(vf4 x, vf4 prev)
+{
+    vf4 r;
+    for(int i = 0; i < 4; i++) {
+        uint32_t z = vresidual(x.v[i], prev.v[i]);
+        std::memcpy(&r.v[i], &z, sizeof(z));
+    }
+    return r;
+}
+
+SIMD_INLINE vf4 vnonfinite(vf4 x)
+{
+    vf4 r;
+    for(int i = 0; i < 4; i++) {
+        uint32_t z = vnonfinite(x.v[i]);
+        std::memcpy(&r.v[i], &z, sizeof(z));
+    }
+    return r;
+}
+
+SIMD_INLINE uint32_t hor(vf4 a)
+{
+    uint32_t r = 0;
+    for(int i = 0; i < 4; i++) {
+        uint32_t z;
+        std::memcpy(&z, &a.v[i], sizeof(z));
+        r |= z;
+    }
+    return r;
+}
+
+#undef VF4_LANEWISE
+
+#endif
+
+// Pack four generator states into a vf4 for vrandom()
+SIMD_INLINE vf4 vrandom_state(const uint32_t seeds[4])
+{
+    float bits[4];
+    std::memcpy(bits, seeds, sizeof(bits));
+    return vf4::load(bits);
+}
+
+// Read one lane; the index need not be a compile-time constant
+SIMD_INLINE float vlane(vf4 a, unsigned int i)
+{
+#if LOOPY_SIMD_NEON
+    switch(i & 3) {
+        case 0: return vgetq_lane_f32(a.v, 0);
+        case 1: return vgetq_lane_f32(a.v, 1);
+        case 2: return vgetq_lane_f32(a.v, 2);
+        default: return vgetq_lane_f32(a.v, 3);
+    }
+#elif LOOPY_SIMD_SSE
+    switch(i & 3) {
+        case 0: return _mm_cvtss_f32(a.v);
+        case 1: return _mm_cvtss_f32(_mm_shuffle_ps(a.v, a.v, 1));
+        case 2: return _mm_cvtss_f32(_mm_movehl_ps(a.v, a.v));
+        default: return _mm_cvtss_f32(_mm_shuffle_ps(a.v, a.v, 3));
+    }
+#else
+    return a.v[i & 3];
+#endif
+}
+
+// ------------------------------------------------------
+// vf8: eight float lanes, AVX2 hosts only
+
+#if LOOPY_SIMD_AVX2
+
+struct vf8 {
+    __m256 v;
+    SIMD_INLINE vf8() {}
+    SIMD_INLINE vf8(__m256 x) : v(x) {}
+    SIMD_INLINE vf8(float x) : v(_mm256_set1_ps(x)) {}
+    static SIMD_INLINE vf8 load(const float* p) { return _mm256_loadu_ps(p); }
+    SIMD_INLINE void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+SIMD_INLINE vf8 operator+(vf8 a, vf8 b) { return _mm256_add_ps(a.v, b.v); }
+SIMD_INLINE vf8 operator-(vf8 a, vf8 b) { return _mm256_sub_ps(a.v, b.v); }
+SIMD_INLINE vf8 operator*(vf8 a, vf8 b) { return _mm256_mul_ps(a.v, b.v); }
+SIMD_INLINE vf8 operator-(vf8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)); }
+SIMD_INLINE vf8 operator<(vf8 a, vf8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+SIMD_INLINE vf8 operator>(vf8 a, vf8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+SIMD_INLINE vf8 operator<=(vf8 a, vf8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+SIMD_INLINE vf8 operator>=(vf8 a, vf8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+SIMD_INLINE vf8 operator&(vf8 a, vf8 b) { return _mm256_and_ps(a.v, b.v); }
+SIMD_INLINE vf8 operator|(vf8 a, vf8 b) { return _mm256_or_ps(a.v, b.v); }
+SIMD_INLINE vf8 vselect(vf8 mask, vf8 a, vf8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+SIMD_INLINE vf8 vmin(vf8 a, vf8 b) { return _mm256_min_ps(a.v, b.v); }
+SIMD_INLINE vf8 vmax(vf8 a, vf8 b) { return _mm256_max_ps(a.v, b.v); }
+SIMD_INLINE vf8 vabs(vf8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+SIMD_INLINE vf8 vrecip(vf8 a) { return _mm256_div_ps(_mm256_set1_ps(1.f), a.v); }
+SIMD_INLINE vf8 vfloor(vf8 x) { return _mm256_floor_ps(x.v); }
+
+SIMD_INLINE vf8 vpow2i(vf8 n)
+{
+    __m256i i = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n.v), _mm256_set1_epi32(127)), 23);
+    return _mm256_castsi256_ps(i);
+}
+
+SIMD_INLINE vf8 vexponent(vf8 x)
+{
+    __m256i i = _mm256_srli_epi32(_mm256_castps_si256(x.v), 23);
+    i = _mm256_sub_epi32(_mm256_and_si256(i, _mm256_set1_epi32(0xff)), _mm256_set1_epi32(126));
+    return _mm256_cvtepi32_ps(i);
+}
+
+SIMD_INLINE vf8 vmantissa(vf8 x)
+{
+    __m256i i = _mm256_castps_si256(x.v);
+    i = _mm256_or_si256(_mm256_and_si256(i, _mm256_set1_epi32((int32_t)0x807fffff)), _mm256_set1_epi32(0x3f000000));
+    return _mm256_castsi256_ps(i);
+}
+
+#endif
+
+#endif //SIMD_H
@@ -0,0 +1,135 @@
+#include "SpectrumAnalyser.h"
+#include <cmath>
+#include <cstring>
+#include "FastMath.h"
+
+#define SPECTRUM_NEW_FRAME 4u       // flag on `middle`: not yet taken
+
+AudioTap::AudioTap()
+    : mask(0),
+      count(0),
+      writing(0)
+{
+}
+
+void AudioTap::resize(unsigned int samples)
+{
+    ring.assign(samples, 0.f);
+    mask = samples - 1;
+    count.store(0);
+    writing.store(0);
+}
+
+void AudioTap::push(const float* block, unsigned int n)
+{
+    uint32_t c = count.load(std::memory_order_relaxed);
+    // readers of what this block overwrites will see it and retry
+    writing.store(c + n, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    unsigned int start = c & mask;
+    unsigned int first = n < ring.size() - start ? n : (unsigned int)ring.size() - start;
+    std::memcpy(&ring[start], block, first * sizeof(float));
+    std::memcpy(&ring[0], block + first, (n - first) * sizeof(float));
+    count.store(c + n, std::memory_order_release);
+}
+
+bool AudioTap::read(uint32_t from, float* dst, unsigned int n) const
+{
+    uint32_t c = count.load(std::memory_order_acquire);
+    if(c - from < n || c - from > ring.size())
+        return false;
+    unsigned int start = from & mask;
+    unsigned int first = n < ring.size() - start ? n : (unsigned int)ring.size() - start;
+    std::memcpy(dst, &ring[start], first * sizeof(float));
+    std::memcpy(dst + first, &ring[0], (n - first) * sizeof(float));
+    // the writer may have lapped the copy meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return writing.load(std::memory_order_relaxed) - from <= ring.size();
+}
+
+SpectrumAnalyser::SpectrumAnalyser()
+    : tap(nullptr),
+      hop(SPECTRUM_SIZE / 4),
+      sampleRate(44100.f),
+      attack(1.f),
+      release(1.f),
+      next(0),
+      back(0),
+      front(1),
+      middle(2),
+      analysed(0),
+      skipped(0)
+{
+}
+
+void SpectrumAnalyser::setup(const AudioTap* source, unsigned int hopSize, float rate)
+{
+    tap = source;
+    hop = hopSize;
+    sampleRate = rate;
+    next = tap ? tap->written() : 0;
+    fft.resize(SPECTRUM_SIZE);
+    frame.assign(SPECTRUM_SIZE, 0.f);
+    bins.resize(SPECTRUM_BINS);
+    power.assign(SPECTRUM_BINS, 0.f);
+    for(unsigned int k = 0; k < 3; k++)
+        slots[k].assign(SPECTRUM_BINS, SPECTRUM_FLOOR);
+    back = 0;
+    front = 1;
+    middle.store(2);
+    setSmoothing(0.01f, 0.3f);
+}
+
+void SpectrumAnalyser::setSmoothing(float attackSeconds, float releaseSeconds)
+{
+    // one-pole coefficients per frame
+    float frameRate = sampleRate / hop;
+    attack = 1.f - std::exp(-1.f / (attackSeconds * frameRate + 1e-9f));
+    release = 1.f - std::exp(-1.f / (releaseSeconds * frameRate + 1e-9f));
+}
+
+bool SpectrumAnalyser::analyseNext()
+{
+    if(!tap)
+        return false;
+    uint32_t written = tap->written();
+    if(written - next < SPECTRUM_SIZE)
+        return false;
+    if(!tap->read(next, frame.data(), SPECTRUM_SIZE)) {
+        // lapped: jump to the newest whole frame, on the hop grid
+        uint32_t behind = written - SPECTRUM_SIZE - next;
+        skipped.fetch_add(behind / hop + 1, std::memory_order_relaxed);
+        next += (behind / hop + 1) * hop;
+        return true;
+    }
+    next += hop;
+
+    for(unsigned int i = 0; i < SPECTRUM_SIZE; i++)
+        frame[i] *= gHannWindow.v[i];
+    fft.forward(frame.data(), bins.data());
+
+    // a full-scale sine peaks at |X| = SPECTRUM_SIZE / 4 through the window
+    const float scale = 16.f / ((float)SPECTRUM_SIZE * SPECTRUM_SIZE);
+    const float dbPerLog2 = 10.f * 0.30102999566f;
+    float* out = slots[back].data();
+    for(unsigned int k = 0; k < SPECTRUM_BINS; k++) {
+        float p = scale * (bins[k].re * bins[k].re + bins[k].im * bins[k].im);
+        power[k] += (p > power[k] ? attack : release) * (p - power[k]);
+        out[k] = power[k] > 1e-12f ? dbPerLog2 * fast_log2(power[k]) : SPECTRUM_FLOOR;
+    }
+    publish();
+    analysed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void SpectrumAnalyser::publish()
+{
+    back = middle.exchange(back | SPECTRUM_NEW_FRAME, std::memory_order_acq_rel) & ~SPECTRUM_NEW_FRAME;
+}
+
+const float* SpectrumAnalyser::latest()
+{
+    if(middle.load(std::memory_order_relaxed) & SPECTRUM_NEW_FRAME)
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~SPECTRUM_NEW_FRAME;
+    return slots[front].data();
+}
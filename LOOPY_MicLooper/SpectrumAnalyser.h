@@ -0,0 +1,103 @@
+#ifndef SPECTRUM_ANALYSER_H
+#define SPECTRUM_ANALYSER_H
+
+// Live spectrum of a signal, for the web UI and diagnostics, with no FFT
+// work on the audio thread.
+//
+// render() pushes each block into an AudioTap, a wait-free ring: one copy
+// and one atomic store per block. A background job (JobScheduler.h, low
+// priority) calls analyseNext(), which takes SPECTRUM_SIZE-sample frames
+// from the tap every `hop` samples, windows them (gHannWindow), transforms
+// them (Fft.h) and folds the power into a per-bin smoothed spectrum with
+// separate attack and release. Each frame of it is published in dB through
+// a triple buffer, so the analysis never waits for a reader and a reader
+// always gets the whole of the newest frame.
+//
+// If the analysis falls more than the ring behind, it skips ahead to the
+// newest frame and counts the skipped frames.
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include "Fft.h"
+#include "Tables.h"
+
+#define SPECTRUM_SIZE   HANN_SIZE
+#define SPECTRUM_BINS   (SPECTRUM_SIZE / 2 + 1)
+#define SPECTRUM_FLOOR  -120.0f                  // dB
+
+// Ring of the last samples pushed, one writer and any number of readers
+class AudioTap {
+public:
+    AudioTap();
+
+    // Power of two samples; not real-time safe
+    void resize(unsigned int samples);
+
+    // ---- audio thread, wait-free
+    void push(const float* block, unsigned int n);
+
+    // ---- readers
+    // Samples pushed so far (wraps at 2^32)
+    uint32_t written() const { return count.load(std::memory_order_acquire); }
+    // Copy samples [from, from + n), counted like written(). False if they
+    // are not all there yet or were overwritten before the copy finished.
+    bool read(uint32_t from, float* dst, unsigned int n) const;
+
+private:
+    std::vector<float> ring;
+    unsigned int mask;
+    std::atomic<uint32_t> count;    // samples published
+    std::atomic<uint32_t> writing;  // end of the block being copied in
+};
+
+class SpectrumAnalyser {
+public:
+    SpectrumAnalyser();
+
+    // Frames of `tap` every `hop` samples; allocates, not real-time safe
+    void setup(const AudioTap* tap, unsigned int hop, float sampleRate);
+    // Smoothing time constants of rising and falling bins
+    void setSmoothing(float attackSeconds, float releaseSeconds);
+
+    // ---- the analysis job, one thread
+    // Analyse the next frame if the tap has it; false once caught up
+    bool analyseNext();
+
+    // ---- one reader thread
+    // The newest smoothed spectrum, SPECTRUM_BINS values in dB (0 dB is a
+    // full-scale sine); valid until the next call
+    const float* latest();
+    float binFrequency(unsigned int bin) const { return bin * sampleRate / SPECTRUM_SIZE; }
+
+    // ---- any thread
+    unsigned int framesAnalysed() const { return analysed.load(std::memory_order_relaxed); }
+    unsigned int framesSkipped() const { return skipped.load(std::memory_order_relaxed); }
+
+private:
+    void publish();
+
+    const AudioTap* tap;
+    unsigned int hop;
+    float sampleRate;
+    float attack;
+    float release;
+    uint32_t next;                  // tap position of the next frame
+
+    Fft fft;
+    std::vector<float> frame;
+    std::vector<Complex> bins;
+    std::vector<float> power;       // smoothed, linear
+
+    // triple buffer: the writer fills `back`, the reader holds `front`,
+    // and `middle` (plus a new-frame flag) is swapped between them
+    std::vector<float> slots[3];
+    unsigned int back;
+    unsigned int front;
+    std::atomic<unsigned int> middle;
+
+    std::atomic<unsigned int> analysed;
+    std::atomic<unsigned int> skipped;
+};
+
+#endif
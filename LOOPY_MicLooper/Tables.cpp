@@ -0,0 +1,123 @@
+#include "Tables.h"
+
+namespace {
+
+constexpr cx::Table<SINE_TABLE_SIZE + 1> makeSine()
+{
+    cx::Table<SINE_TABLE_SIZE + 1> t = {};
+    for(unsigned int i = 0; i <= SINE_TABLE_SIZE; i++)
+        t.v[i] = (float)cx::sin(2.0 * cx::kPi * i / SINE_TABLE_SIZE);
+    return t;
+}
+
+constexpr cx::Table<HANN_SIZE> makeHann()
+{
+    cx::Table<HANN_SIZE> t = {};
+    for(unsigned int i = 0; i < HANN_SIZE; i++)
+        t.v[i] = (float)(0.5 - 0.5 * cx::cos(2.0 * cx::kPi * i / HANN_SIZE));
+    return t;
+}
+
+// Blackman-windowed sinc. Phase p holds the taps for a read position
+// p / SINC_PHASES samples past tap SINC_TAPS/2 - 1; each phase is
+// normalised to unity gain at DC.
+constexpr cx::Table2D<SINC_PHASES + 1, SINC_TAPS> makeSinc()
+{
+    cx::Table2D<SINC_PHASES + 1, SINC_TAPS> t = {};
+    for(unsigned int p = 0; p <= SINC_PHASES; p++) {
+        double frac = (double)p / SINC_PHASES;
+        double h[SINC_TAPS] = {};
+        double sum = 0.0;
+        for(unsigned int j = 0; j < SINC_TAPS; j++) {
+            double x = (double)j - (SINC_TAPS / 2 - 1) - frac;
+            double w = (x + SINC_TAPS / 2) / SINC_TAPS; // window position in [0..1]
+            double window = 0.42 - 0.5 * cx::cos(2.0 * cx::kPi * w) + 0.08 * cx::cos(4.0 * cx::kPi * w);
+            h[j] = cx::sinc(x) * window;
+            sum += h[j];
+        }
+        for(unsigned int j = 0; j < SINC_TAPS; j++)
+            t.v[p][j] = (float)(h[j] / sum);
+    }
+    return t;
+}
+
+// 40 dB exponential taper: 0 -> 0, 0.5 -> ~0.09, 1 -> 1
+constexpr cx::Table<TAPER_SIZE + 1> makeTaperLog()
+{
+    cx::Table<TAPER_SIZE + 1> t = {};
+    double k = 4.605170185988091; // ln(100)
+    for(unsigned int i = 0; i <= TAPER_SIZE; i++)
+        t.v[i] = (float)((cx::exp(k * i / TAPER_SIZE) - 1.0) / 99.0);
+    return t;
+}
+
+constexpr cx::Table<TAPER_SIZE + 1> makeTaperAntiLog()
+{
+    cx::Table<TAPER_SIZE + 1> log = makeTaperLog();
+    cx::Table<TAPER_SIZE + 1> t = {};
+    for(unsigned int i = 0; i <= TAPER_SIZE; i++)
+        t.v[i] = 1.0f - log.v[TAPER_SIZE - i];
+    return t;
+}
+
+constexpr cx::Table<EXP_CURVE_SIZE + 1> makeExpCurve()
+{
+    cx::Table<EXP_CURVE_SIZE + 1> t = {};
+    for(unsigned int i = 0; i <= EXP_CURVE_SIZE; i++)
+        t.v[i] = (float)cx::exp(-(double)EXP_CURVE_RANGE * i / EXP_CURVE_SIZE);
+    return t;
+}
+
+// One cycle of each morphable LFO shape in [0..1], all peaking at phase 0
+// and bottoming out at 0.5 so that blending neighbours never cancels
+constexpr cx::Table2D<MORPH_SHAPES, MORPH_TABLE_SIZE + 1> makeMorph()
+{
+    cx::Table2D<MORPH_SHAPES, MORPH_TABLE_SIZE + 1> t = {};
+    for(unsigned int i = 0; i <= MORPH_TABLE_SIZE; i++) {
+        double p = (double)i / MORPH_TABLE_SIZE;
+        double d = p < 0.5 ? p : 1.0 - p; // distance from the peak
+        double sine = 0.5 + 0.5 * cx::cos(2.0 * cx::kPi * p);
+
+        // the click-less square of run_lfo(): a compressed sine
+        double x = sine - 0.5;
+        x *= 1.0 / (1.0 + 30.0 * (x < 0.0 ? -x : x));
+
+        t.v[0][i] = (float)sine;
+        t.v[1][i] = (float)(1.0 - 2.0 * d);
+        t.v[2][i] = (float)(16.0 * x + 0.5);
+        t.v[3][i] = (float)((1.0 + 1.0 / 2.718281828459045) * cx::exp(-2.0 * 1.3133 * d) - 1.0 / 2.718281828459045);
+    }
+    return t;
+}
+
+// Odd branch of a Blackman-windowed half-band filter: tap j weights the
+// sample j steps back for a point halfway between samples N/2-1 and N/2
+// back. Normalised to unity gain at DC; the even branch is a plain delay.
+template <unsigned int N>
+constexpr cx::Table<N> makeHalfband()
+{
+    cx::Table<N> t = {};
+    double h[N] = {};
+    double sum = 0.0;
+    for(unsigned int j = 0; j < N; j++) {
+        double x = (double)N / 2 - 0.5 - j;
+        double window = 0.42 + 0.5 * cx::cos(2.0 * cx::kPi * x / N) + 0.08 * cx::cos(4.0 * cx::kPi * x / N);
+        h[j] = cx::sinc(x) * window;
+        sum += h[j];
+    }
+    for(unsigned int j = 0; j < N; j++)
+        t.v[j] = (float)(h[j] / sum);
+    return t;
+}
+
+} // namespace
+
+constexpr cx::Table<SINE_TABLE_SIZE + 1> gSineTable = makeSine();
+constexpr cx::Table<HANN_SIZE> gHannWindow = makeHann();
+constexpr cx::Table2D<SINC_PHASES + 1, SINC_TAPS> gSincTable = makeSinc();
+constexpr cx::Table<TAPER_SIZE + 1> gTaperLog = makeTaperLog();
+constexpr cx::Table<TAPER_SIZE + 1> gTaperAntiLog = makeTaperAntiLog();
+constexpr cx::Table<EXP_CURVE_SIZE + 1> gExpCurve = makeExpCurve();
+constexpr cx::Table2D<MORPH_SHAPES, MORPH_TABLE_SIZE + 1> gMorphTable = makeMorph();
+constexpr cx::Table<HALFBAND_LONG> gHalfbandLong = makeHalfband<HALFBAND_LONG>();
+constexpr cx::Table<HALFBAND_SHORT> gHalfbandShort = makeHalfband<HALFBAND_SHORT>();
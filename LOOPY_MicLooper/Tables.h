@@ -0,0 +1,131 @@
+#ifndef TABLES_H
+#define TABLES_H
+
+// Fixed lookup tables, generated by the compiler from the constexpr
+// functions below and defined once in Tables.cpp. They are plain const
+// data, so they live in .rodata, cost nothing at boot and are shared by
+// every LFO, delay line and analyser instance.
+
+#define SINE_TABLE_SIZE   1024   // one period, plus a guard point
+#define HANN_SIZE         1024   // periodic Hann, for overlapped FFT frames
+#define SINC_TAPS         8      // windowed-sinc fractional delay taps
+#define SINC_PHASES       64     // fractional positions, plus a guard phase
+#define TAPER_SIZE        256    // knob tapers over [0..1], plus a guard point
+#define EXP_CURVE_SIZE    1024   // exp(-x) over [0..EXP_CURVE_RANGE], plus a guard point
+#define EXP_CURVE_RANGE   8.0f
+#define MORPH_SHAPES      4      // sine, triangle, square, exponential
+#define MORPH_TABLE_SIZE  256    // one LFO cycle per shape, plus a guard point
+#define HALFBAND_LONG     16     // half-band taps per polyphase branch, 2x stage
+#define HALFBAND_SHORT    8      // same, for the 2x -> 4x stage
+
+// ------------------------------------------------------
+// constexpr generators (double precision, compile time only)
+
+namespace cx {
+
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double sin(double x)
+{
+    // reduce to [-pi, pi], then to [-pi/2, pi/2] by symmetry
+    long long k = (long long)(x / (2.0 * kPi) + (x < 0.0 ? -0.5 : 0.5));
+    x -= (double)k * 2.0 * kPi;
+    if(x > kPi / 2.0) x = kPi - x;
+    if(x < -kPi / 2.0) x = -kPi - x;
+
+    double term = x, sum = x, x2 = x * x;
+    for(int n = 1; n < 10; n++) {
+        term *= -x2 / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cos(double x)
+{
+    return sin(x + kPi / 2.0);
+}
+
+constexpr double exp(double x)
+{
+    // exp(x) = exp(x / 2^k)^(2^k) with |x / 2^k| < 0.5
+    int k = 0;
+    while(x > 0.5 || x < -0.5) {
+        x *= 0.5;
+        k++;
+    }
+    double term = 1.0, sum = 1.0;
+    for(int n = 1; n < 14; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    while(k-- > 0)
+        sum *= sum;
+    return sum;
+}
+
+constexpr double sinc(double x)
+{
+    return (x > -1e-9 && x < 1e-9) ? 1.0 : sin(kPi * x) / (kPi * x);
+}
+
+template <unsigned int N>
+struct Table {
+    float v[N];
+};
+
+template <unsigned int Rows, unsigned int Cols>
+struct Table2D {
+    float v[Rows][Cols];
+};
+
+} // namespace cx
+
+// ------------------------------------------------------
+// The tables
+
+extern const cx::Table<SINE_TABLE_SIZE + 1> gSineTable;
+extern const cx::Table<HANN_SIZE> gHannWindow;
+extern const cx::Table2D<SINC_PHASES + 1, SINC_TAPS> gSincTable;
+extern const cx::Table<TAPER_SIZE + 1> gTaperLog;      // audio taper, 40 dB range
+extern const cx::Table<TAPER_SIZE + 1> gTaperAntiLog;  // mirror of the audio taper
+extern const cx::Table<EXP_CURVE_SIZE + 1> gExpCurve;
+extern const cx::Table2D<MORPH_SHAPES, MORPH_TABLE_SIZE + 1> gMorphTable;
+extern const cx::Table<HALFBAND_LONG> gHalfbandLong;
+extern const cx::Table<HALFBAND_SHORT> gHalfbandShort;
+
+// Linear interpolation into a table of size+1 points covering x in [0..1]
+inline float table_lookup(const float* table, unsigned int size, float x)
+{
+    if(x <= 0.0f) return table[0];
+    if(x >= 1.0f) return table[size];
+    float pos = x * (float)size;
+    unsigned int i = (unsigned int)pos;
+    float frac = pos - (float)i;
+    return table[i] + frac * (table[i + 1] - table[i]);
+}
+
+// sin(2*pi*phase) for any phase, from the sine table
+inline float table_sin(float phase)
+{
+    int whole = (int)phase;
+    float p = phase - (float)(whole - (phase < (float)whole));
+    float pos = p * SINE_TABLE_SIZE;
+    unsigned int i = (unsigned int)pos;
+    if(i >= SINE_TABLE_SIZE) i = SINE_TABLE_SIZE - 1;
+    float frac = pos - (float)i;
+    return gSineTable.v[i] + frac * (gSineTable.v[i + 1] - gSineTable.v[i]);
+}
+
+inline float table_cos(float phase)
+{
+    return table_sin(phase + 0.25f);
+}
+
+// exp(-x) for x >= 0; clamps to exp(-EXP_CURVE_RANGE) beyond the table
+inline float table_exp_neg(float x)
+{
+    return table_lookup(gExpCurve.v, EXP_CURVE_SIZE, x * (1.0f / EXP_CURVE_RANGE));
+}
+
+#endif //TABLES_H
@@ -2,14 +2,20 @@
   lfo.cpp: Provides various Low-Frequency Oscillator (LFO) implementations
   for real-time audio applications. This includes integrated triangle,
   triangle, sine, square (compressed sine), exponential, and RC relaxation
-  oscillator variants. The code defines functions to initialize an LFO,
-  update its frequency, and run the selected LFO type each frame.
+  oscillator variants, plus sample-and-hold, smooth random and drunk-walk
+  shapes driven by a seedable xorshift32 generator, and a morphing shape
+  that blends continuously from sine to triangle to square to
+  exponential. The code defines functions to initialize an LFO, update
+  its frequency, and run the selected LFO type each frame.
 
   Typical usage:
     1) Call init_lfo() to allocate and configure lfoparams, specifying
        base frequency (fosc), sample rate (fs), and initial phase.
-    2) Optionally call update_lfo() to change the LFO rate at runtime.
-    3) Call run_lfo() each audio frame (or as needed) to get a normalized
+    2) Optionally call update_lfo() to change the LFO rate at runtime,
+       or lock_lfo_to_length() to fit a whole number of cycles into a loop.
+    3) Call set_lfo_phase() / reset_lfo() to retrigger at a loop boundary,
+       and seed_lfo() to make the random shapes reproducible.
+    4) Call run_lfo() each audio frame (or as needed) to get a normalized
        oscillator value in [0,1], which can be mapped to target parameters
        (e.g. delay time, feedback, pitch).
 
@@ -22,6 +28,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include "lfo.h"
+#include "FastMath.h"
+#include "Tables.h"
 
 /*
   init_lfo():
@@ -72,12 +80,12 @@ lfoparams* init_lfo(lfoparams* lp, float fosc, float fs, float phase)
     
     // Sine wave LFO variables
     lp->ksin = M_PI * frq / fs;
-    lp->sin_part = sin(2.0 * M_PI * phase / 360.0);
-    lp->cos_part = cos(2.0 * M_PI * phase / 360.0);
+    lp->sin_part = table_sin(phase / 360.0f);
+    lp->cos_part = table_cos(phase / 360.0f);
     
     // RC relaxation oscillator parameters
     float ie = 1.0 / (1.0 - 1.0 / M_E);
-    float k = expf(-2.0 * fosc / fs);
+    float k = fast_exp(-2.0f * fosc / fs);
 
     lp->rlx_k = k;
     lp->rlx_ik = 1.0 - k;
@@ -88,18 +96,31 @@ lfoparams* init_lfo(lfoparams* lp, float fosc, float fs, float phase)
     lp->rlx_lfo = 0.0;
 
     // Exponential oscillator parameters
-    k = expf(-2.0 * 1.3133f * fosc / fs);
+    k = fast_exp(-2.0f * 1.3133f * fosc / fs);
     lp->exp_ik = k;
     lp->exp_k = 1.0 / k;
     lp->exp_x = k;
     lp->exp_min = 1.0 / M_E;
     lp->exp_max = 1.0 + 1.0 / M_E;
     lp->exp_sv = lp->exp_min;
+
+    // Random shapes: a fixed default seed, so renders repeat unless reseeded
+    lp->rnd_walk = 0.25f;
+    seed_lfo(lp, 1);
+
+    // Morphing shape: starts as a sine, glides with a ~10ms time constant
+    lp->morph = lp->morph_target = 0.0f;
+    lp->morph_k = 1.0f - fast_exp(-100.0f / fs);
     
     // Global fields
     lp->current_rate = fosc;
     lp->lfo_type = 0; // default to integrated triangle
 
+    // Phase tracking
+    p = phase / 360.0;
+    lp->phase = p - fast_floor(p);
+    lp->phase_inc = fosc / fs;
+
     return lp; 
 }
 
@@ -116,6 +137,7 @@ void update_lfo(lfoparams* lp, float fosc, float fs)
 
     // Keep track of new rate
     lp->current_rate = fosc;
+    lp->phase_inc = fosc / fs;
     
     // Integrated triangle LFO re-init
     lp->k_ = 2.0f * ts * frq;
@@ -130,13 +152,16 @@ void update_lfo(lfoparams* lp, float fosc, float fs)
     // Sine wave
     lp->ksin = M_PI * frq / fs;
 
+    // Morph glide
+    lp->morph_k = 1.0f - fast_exp(-100.0f / fs);
+
     // Relaxation oscillator
-    float k = expf(-2.0f * fosc / fs);
+    float k = fast_exp(-2.0f * fosc / fs);
     lp->rlx_k = k;
     lp->rlx_ik = 1.0f - k;
     
     // Exponential oscillator
-    k = expf(-2.0f * 1.3133f * fosc / fs);
+    k = fast_exp(-2.0f * 1.3133f * fosc / fs);
     lp->exp_ik = k;
     lp->exp_k = 1.0f / k;
     
@@ -263,6 +288,58 @@ float run_exp_lfo(lfoparams* lp)
     return lp->exp_sv - lp->exp_min;
 }
 
+/*
+  next_random_lfo():
+    Called once per cycle, at the phase wrap. Draws the value the random
+    shapes move to over the next cycle. The drunk walk takes a step of up
+    to +/- rnd_walk from where it is and reflects off 0 and 1.
+*/
+static void next_random_lfo(lfoparams* lp)
+{
+    float r = vrandom(lp->rnd_state);
+    lp->rnd_prev = lp->rnd_next;
+    if(lp->lfo_type == DRUNK) {
+        r = lp->rnd_prev + lp->rnd_walk * (2.0f * r - 1.0f);
+        if(r < 0.0f) r = -r;
+        if(r > 1.0f) r = 2.0f - r;
+    }
+    lp->rnd_next = r;
+}
+
+/*
+  run_random_lfo():
+    Smooth random and drunk walk glide from rnd_prev to rnd_next over one
+    cycle with a smoothstep, which has zero slope at the cycle ends, so
+    consecutive segments join without corners. No oscillator state to
+    update per call: the cost is a handful of multiplies.
+*/
+float run_random_lfo(lfoparams* lp)
+{
+    float p = lp->phase;
+    float s = p * p * (3.0f - 2.0f * p);
+    return lp->rnd_prev + s * (lp->rnd_next - lp->rnd_prev);
+}
+
+/*
+  run_morph_lfo():
+    Reads the two shapes either side of the morph position from the
+    precomputed one-cycle tables (Tables.h) at the current phase and blends
+    them. The cost is the same wherever the morph sits; the position
+    glides towards morph_target, so moving it does not click.
+*/
+float run_morph_lfo(lfoparams* lp)
+{
+    lp->morph += lp->morph_k * (lp->morph_target - lp->morph);
+
+    int row = (int)lp->morph;
+    if(row > MORPH_SHAPES - 2) row = MORPH_SHAPES - 2;
+    float frac = lp->morph - (float)row;
+
+    float a = table_lookup(gMorphTable.v[row], MORPH_TABLE_SIZE, lp->phase);
+    float b = table_lookup(gMorphTable.v[row + 1], MORPH_TABLE_SIZE, lp->phase);
+    return a + frac * (b - a);
+}
+
 /*
   run_lfo():
     Wrapper function that chooses the appropriate LFO shape
@@ -309,19 +386,39 @@ float run_lfo(lfoparams* lp)
             
         case HYPER: // smooth bottom, triangular top
             lfo_out = run_integrated_triangle_lfo(lp);
-            lfo_out = 1.0f - fabsf(lfo_out - 0.5f);
+            lfo_out = 1.0f - vabs(lfo_out - 0.5f);
             break;
     	
     	case HYPER_SINE:  // sine bottom, triangular top
             lfo_out = run_sine_lfo(lp);
-            lfo_out = 1.0f - fabsf(lfo_out - 0.5f);
+            lfo_out = 1.0f - vabs(lfo_out - 0.5f);
             break;    	
+
+        case SAMPLE_HOLD: // new random level each cycle
+            lfo_out = lp->rnd_next;
+            break;
+
+        case SMOOTH_RANDOM: // random levels, interpolated
+        case DRUNK: // bounded random walk, interpolated
+            lfo_out = run_random_lfo(lp);
+            break;
+
+        case MORPH: // continuous blend of sine, triangle, square, exp
+            lfo_out = run_morph_lfo(lp);
+            break;
             
         default:
             // fallback to integrated triangle
             lfo_out = run_integrated_triangle_lfo(lp);
             break;
     }
+
+    lp->phase += lp->phase_inc;
+    if(lp->phase >= 1.0f) {
+        lp->phase -= 1.0f;
+        next_random_lfo(lp);
+    }
+
     return lfo_out;
 }
 
@@ -362,6 +459,18 @@ void get_lfo_name(unsigned int type, char* outstring)
         case HYPER_SINE:
             sprintf(outstring, "HYPER_SINE");
             break;
+        case SAMPLE_HOLD:
+            sprintf(outstring, "SAMPLE & HOLD");
+            break;
+        case SMOOTH_RANDOM:
+            sprintf(outstring, "SMOOTH RANDOM");
+            break;
+        case DRUNK:
+            sprintf(outstring, "DRUNK");
+            break;
+        case MORPH:
+            sprintf(outstring, "MORPH");
+            break;
         default:
             sprintf(outstring, "DEFAULT: INTEGRATED TRIANGLE");
             break;
@@ -375,4 +484,138 @@ void get_lfo_name(unsigned int type, char* outstring)
 void set_lfo_type(lfoparams* lp, unsigned int type) 
 {
     lp->lfo_type = type;
-}
\ No newline at end of file
+}
+
+/*
+  set_lfo_phase():
+    Jumps every oscillator to the given cycle position (0..1, wrapped),
+    where 0 is the state init_lfo() leaves a shape in at phase 0. The
+    state variables are rebuilt from closed-form expressions of each
+    shape, so the oscillators continue from exactly that point of the
+    cycle. Any pending integrated-triangle startup delay is cancelled.
+*/
+void set_lfo_phase(lfoparams* lp, float phase)
+{
+    float p = phase - fast_floor(phase);
+    float q;
+
+    lp->phase = p;
+    lp->startup_delay = 0;
+
+    // Integrated triangle: x is a triangle of amplitude k with period
+    // 1/fosc, lfo its running sum, rising 0..1 over the first half cycle
+    lp->k = lp->k_;
+    lp->nk = lp->nk_;
+    if(p < 0.25f) {
+        lp->x = lp->k * 4.0f * p;
+        lp->sign = lp->psign_;
+        lp->lfo = 8.0f * p * p;
+    } else if(p < 0.5f) {
+        q = 0.5f - p;
+        lp->x = lp->k * 4.0f * q;
+        lp->sign = lp->nsign_;
+        lp->lfo = 1.0f - 8.0f * q * q;
+    } else if(p < 0.75f) {
+        q = p - 0.5f;
+        lp->x = -lp->k * 4.0f * q;
+        lp->sign = lp->nsign_;
+        lp->lfo = 1.0f - 8.0f * q * q;
+    } else {
+        q = 1.0f - p;
+        lp->x = -lp->k * 4.0f * q;
+        lp->sign = lp->psign_;
+        lp->lfo = 8.0f * q * q;
+    }
+
+    // Triangle: rising 0..1 over the first half cycle
+    if(p < 0.5f) {
+        lp->trilfo = 2.0f * p;
+        lp->trisign = 1.0f;
+    } else {
+        lp->trilfo = 2.0f - 2.0f * p;
+        lp->trisign = -1.0f;
+    }
+
+    // Sine: rotate the quadrature pair to the new angle
+    lp->sin_part = table_sin(p);
+    lp->cos_part = table_cos(p);
+
+    // RC relaxation: charges 0..1 in half a cycle, then discharges
+    if(p < 0.5f) {
+        lp->rlx_lfo = lp->rlx_max * (1.0f - table_exp_neg(2.0f * p));
+        lp->rlx_sign = lp->rlx_max;
+    } else {
+        lp->rlx_lfo = 1.0f - lp->rlx_max * (1.0f - table_exp_neg(2.0f * (p - 0.5f)));
+        lp->rlx_sign = lp->rlx_min;
+    }
+
+    // Exponential: grows exp_min..exp_max in half a cycle, then decays.
+    // exp_max = exp_min * e^1.3133, so both halves read the decaying curve.
+    if(p < 0.5f) {
+        lp->exp_sv = lp->exp_max * table_exp_neg(2.0f * 1.3133f * (0.5f - p));
+        lp->exp_x = lp->exp_k;
+    } else {
+        lp->exp_sv = lp->exp_max * table_exp_neg(2.0f * 1.3133f * (p - 0.5f));
+        lp->exp_x = lp->exp_ik;
+    }
+}
+
+/*
+  reset_lfo():
+    Retriggers the LFO at the start of its cycle.
+*/
+void reset_lfo(lfoparams* lp)
+{
+    set_lfo_phase(lp, 0.0f);
+}
+
+/*
+  lock_lfo_to_length():
+    Sets the rate so that exactly `cycles` LFO periods fit into `length`
+    calls of run_lfo() (e.g. one loop pass, counted at the rate the LFO
+    is clocked at, fs). Combined with set_lfo_phase() at the loop
+    boundary this makes the modulation identical on every pass.
+*/
+void lock_lfo_to_length(lfoparams* lp, float length, float cycles, float fs)
+{
+    if(length < 1.0f || cycles <= 0.0f)
+        return;
+    update_lfo(lp, cycles * fs / length, fs);
+}
+
+/*
+  seed_lfo():
+    Restarts the random shapes from `seed`: the same seed and rate give
+    the same modulation on every render.
+*/
+void seed_lfo(lfoparams* lp, uint32_t seed)
+{
+    lp->rnd_state = vrandom_seed(seed, 0);
+    lp->rnd_prev = vrandom(lp->rnd_state);
+    lp->rnd_next = vrandom(lp->rnd_state);
+}
+
+/*
+  set_lfo_walk():
+    Sets how far the drunk walk may move per cycle, as a fraction of
+    the [0..1] output range.
+*/
+void set_lfo_walk(lfoparams* lp, float step)
+{
+    if(step < 0.0f) step = 0.0f;
+    if(step > 1.0f) step = 1.0f;
+    lp->rnd_walk = step;
+}
+
+/*
+  set_lfo_morph():
+    Sets where the MORPH shape sits: 0 = sine, 1 = triangle, 2 = square,
+    3 = exponential, fractional values blend the neighbours. The shape
+    glides to the new position rather than jumping.
+*/
+void set_lfo_morph(lfoparams* lp, float position)
+{
+    if(position < 0.0f) position = 0.0f;
+    if(position > (float)(MORPH_SHAPES - 1)) position = (float)(MORPH_SHAPES - 1);
+    lp->morph_target = position;
+}
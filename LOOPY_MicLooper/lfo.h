@@ -2,6 +2,8 @@
 #ifndef LFO_H
 #define LFO_H
 
+#include <stdint.h>
+
 #define INT_TRI    	0
 #define TRI        	1
 #define SINE       	2
@@ -10,7 +12,11 @@
 #define RELAX      	5
 #define HYPER		6
 #define HYPER_SINE	7
-#define MAX_LFOS   	7
+#define SAMPLE_HOLD	8
+#define SMOOTH_RANDOM	9
+#define DRUNK		10
+#define MORPH		11
+#define MAX_LFOS   	11
 
 
 typedef struct lfoparams_t {
@@ -49,8 +55,25 @@ typedef struct lfoparams_t {
     float exp_sv;
     float exp_x;
     
+    //Random shapes: xorshift32 state, the value drawn at the start of
+    //the current cycle and the one before it, max drunk step per cycle
+    uint32_t rnd_state;
+    float rnd_prev;
+    float rnd_next;
+    float rnd_walk;
+
+    //Morphing shape: position along sine-triangle-square-exp, the
+    //target it glides to and the per-call glide coefficient
+    float morph;
+    float morph_target;
+    float morph_k;
+
     //globals
     float current_rate;
+
+    //Phase tracking: cycle position in [0,1) and per-call increment
+    float phase;
+    float phase_inc;
     
     //Select LFO type 
     unsigned int lfo_type;
@@ -61,6 +84,12 @@ void update_lfo(lfoparams*, float, float);
 void set_lfo_type(lfoparams*, unsigned int);
 void get_lfo_name(unsigned int, char*);
 float run_lfo(lfoparams* );
+void set_lfo_phase(lfoparams*, float);
+void reset_lfo(lfoparams*);
+void lock_lfo_to_length(lfoparams*, float, float, float);
+void seed_lfo(lfoparams*, uint32_t);
+void set_lfo_walk(lfoparams*, float);
+void set_lfo_morph(lfoparams*, float);
 
 #endif //LFO_H
 
@@ -14,7 +14,10 @@
       4) Playback Speed (analog3): [-2.0..+2.0]
     - Two digital buttons:
       - Record/Play toggle
-      - Clear buffer (reset all loops)
+      - Clear buffer (reset all loops), on release
+      - Record pressed while Clear is held: measure the round-trip latency
+        (hold the mic to the speaker), so overdubs line up with what was heard.
+        The loop is kept: Clear only clears when released without Record.
     - LED indicator (digital output):
       - ON when recording, OFF when paused/playing
 
@@ -24,209 +27,896 @@
 #include <Bela.h>
 #include <cmath>
 #include <vector>
+#include <atomic>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+#include "EngineConfig.h"
 #include "DelayEffect.h"
 #include "lfo.h"
+#include "ModCurve.h"
+#include "InputStage.h"
+#include "EnvelopeFollower.h"
+#include "ModMatrix.h"
+#include "LoopBuffer.h"
+#include "LoopBank.h"
+#include "LatencyCalibrator.h"
+#include "Pipeline.h"
+#include "JobScheduler.h"
+#include "SpectrumAnalyser.h"
+#include "LoopPointFinder.h"
+
+// ------------------------------------------------------
+// The engine configuration this build is specialised for (EngineConfig.h),
+// and the same with what Bela actually runs at, for the generic path when
+// the two differ
+constexpr EngineConfig gEngineConfig = ENGINE_PROFILE;
+EngineConfig gRuntimeConfig = gEngineConfig;
+bool gSpecialised = true;
 
 // ------------------------------------------------------
 // Global state: ring buffer for audio, pointers, etc.
-std::vector<float> gAudioBuffer;
-int gBufferSize = 44100 * 20; // up to ~20 sec or more
+// Chunked, so other threads can copy the loop out while we overdub, and
+// multiplying the loop shares its chunks instead of copying them. The
+// spare buffer is where a stored loop is decoded before switching to it.
+LoopBuffer gLoopBuffers[2];
+LoopBuffer* gAudioBuffer = &gLoopBuffers[0];
+LoopBuffer* gSpareBuffer = &gLoopBuffers[1];
+int gLoopLength = 0;          // 0 until the first take closes the loop
 int gWritePointer = 0;
 int gReadPointer  = 0;
 unsigned int gAudioFramesPerAnalogFrame = 0;
+int gLoopCheckStart = 0;      // first loop slot written since the last NaN/Inf check
 static float readIndex = 0.0f; // playback pointer
 
 // Recording/playback states
 bool gRecording      = false;
 bool gPlaying        = false;
 bool gClearBuffer    = false;
-bool gClearedOnce    = false;
+bool gClearPending   = false; // Clear is held and clears on release
 float gPlaybackSpeed = 1.0f;  
 
-// Pin definitions
-int gButtonPin       = 7;    // record/play button
-int gClearButtonPin  = 10;   // clear buffer button
-int gLEDPin          = 6;    // LED indicator
+// Button edges; the pins and analog channels are in the engine config
 int gLastButtonState = 0;
 int gLastClearButtonState = 0;
 
-// Analog inputs
-//  - analog0: Delay Mix
-//  - analog1: Delay Feedback
-//  - analog2: LFO Depth => modulates delay time
-//  - analog3: Playback Speed => [-2..+2]
-int gAnalogDelayMixChannel    = 0;
-int gAnalogFeedbackChannel    = 1;
-int gAnalogLfoDepthChannel    = 2;
-int gAnalogSpeedChannel       = 3;
+// Mic conditioning (DC blocker + noise gate), run on whole input blocks
+InputStage gInputStage(gEngineConfig.sampleRate);
+std::vector<float> gInputBlock;
+
+// Envelope of the conditioned input, a second modulation source next to
+// the LFO. Route it through gModMatrix to use it.
+EnvelopeFollower gEnvelope(gEngineConfig.sampleRate);
+
+// Knobs, LFO and envelope reach the delay and looper through the matrix,
+// evaluated once per block; the results are ramped across the block.
+ModMatrix gModMatrix;
+
+// Background work (bank switches, calibration analysis) runs as jobs on one
+// auxiliary task, a few milliseconds at a time with rests in between.
+// render() enqueues them without locks.
+#define JOB_SLICE_US 2000
+#define JOB_REST_US  500
+JobScheduler gJobs;
+AuxiliaryTask gJobTask;
+
+// Stored loops, compressed, swapped with the playing one by two jobs: one
+// decodes the requested bank into gSpareBuffer and hands it over through
+// gBankReady; render() swaps buffers at the next block start and hands the
+// old one to the other for compression. Both work a few chunks per step.
+#define LOOP_BANKS 8
+#define BANK_CHUNKS_PER_STEP 8
+LoopBank gLoopBank;
+unsigned int gActiveBank = 0;
+bool gBankSwitching = false;             // render() only
+std::atomic<int> gBankReady(-1);         // job -> render(): decoded bank
+unsigned int gBankReadyLength = 0;       // published by gBankReady
+
+// Round-trip latency, measured on request and applied where overdubs
+// start: a layer is written this many samples behind the play head, where
+// the material the player was hearing actually is
+LatencyCalibrator gLatencyCalibrator;
+bool gLatencyPending = false;
+int gOverdubOffset = 0;
+std::vector<float> gCalibrationOut;
+
+// Effect chain after the looper, empty unless stages are added in setup().
+// It runs inline; with gPipelineWorkers > 0 (multi-core hosts only) its
+// stages are spread over that many threads, at that many blocks (plus one
+// of slack) of extra latency.
+Pipeline gOutputChain;
+unsigned int gPipelineWorkers = 0;
+std::vector<float> gOutputBlock;
+
+// Live spectra of the mic input and the final output, for the web UI and
+// diagnostics: render() copies each block into a tap, and a low-priority
+// job runs the FFTs whenever a hop's worth has arrived. Read them with
+// inputSpectrum() / outputSpectrum().
+#define SPECTRUM_TAP_SIZE 8192
+#define SPECTRUM_HOP      (SPECTRUM_SIZE / 2)
+AudioTap gInputTap;
+AudioTap gOutputTap;
+SpectrumAnalyser gInputSpectrum;
+SpectrumAnalyser gOutputSpectrum;
+unsigned int gSpectrumFrames = 0;        // render() only: pushed since the last job
+
+// Loop points of a first take closed by hand, refined by a job that finds
+// where the phrase comes round again (up to half a second before the
+// press) and applied at a block boundary. gTake counts every change to the
+// loop's layout or contents; a result for an older take is dropped.
+#define LOOP_POINT_SEARCH  (gRuntimeConfig.sampleRate / 2)
+#define LOOP_POINT_WINDOW  8192
+#define LOOP_POINT_BUDGET  0.25f         // seconds
+LoopPointFinder gLoopPointFinder;
+int gTake = 0;
+bool gFindLoopPoints = false;            // render() only: a take closed this block
 
 // DelayEffect instance with initial parameters
-DelayEffect delayEffect(44100, 0.5f, 0.7f, 44100);
+DelayEffect delayEffect(gEngineConfig.sampleRate, 0.5f, 0.7f, gEngineConfig.delaySamples);
+
+// Telemetry: NaN/Inf events cleared from the loop and delay buffers
+unsigned int gNonFiniteEvents = 0;
+unsigned int gReportedNonFiniteEvents = 0;
 
 // LFO pointer for modulating delay time
 lfoparams* gLFO = nullptr;
+unsigned int gFramesPerLfoTick = 0; // run_lfo() is called once per block
+float gLfoClockRate = gEngineConfig.sampleRate;
+float gLfoCyclesPerLoop = 1.0f;   // tempo-lock: whole LFO cycles per loop pass
+float gLfoSyncPhase = 0.0f;       // phase the LFO is retriggered to at the loop start
+
+// Cached LFO curve for one loop pass, one point per 32 LFO ticks. It is
+// rendered a slice per block once the loop closes and replayed afterwards,
+// so steady playback runs no oscillator code at all.
+ModCurve gLfoCurve(gEngineConfig.maxLoopSamples, 32);
+unsigned int gLfoCurveTicksPerBlock = 256;
+#define LFO_MORPH_SETTLE 0.05f           // seconds the morph must rest before the curve is re-rendered
+unsigned int gLfoMorphSettle = 0;        // LFO ticks left until then, 0 when none is pending
+
+// Retrigger the LFO so that the loop start, crossed at (possibly fractional)
+// frame `start` of the current block, lands exactly on gLfoSyncPhase. The LFO
+// only advances at block starts, so the phase is pre-wound by the fraction
+// of a step between the crossing and the first LFO tick after frame n.
+static void retriggerLfo(unsigned int n, float start)
+{
+    if(!gFramesPerLfoTick)
+        return;
+    unsigned int nextTick = n + gFramesPerLfoTick - n % gFramesPerLfoTick;
+    float offset = ((float)nextTick - start) / (float)gFramesPerLfoTick - 1.0f;
+    set_lfo_phase(gLFO, gLfoSyncPhase + offset * gLFO->phase_inc);
+    gLfoCurve.restart(offset);
+}
 
-// ------------------------------------------------------
-// Setup runs once before audio processing begins
-bool setup(BelaContext *context, void *userData)
+// Re-render the cached curve after the LFO's rate or shape changed. The live
+// oscillator is first moved to where the cursor is, so modulation carries on
+// from the same point while the new curve renders.
+static void refreshLfoCurve()
 {
-    // Determine ratio of audioFrames to analogFrames
-    if(context->analogFrames)
-        gAudioFramesPerAnalogFrame = context->audioFrames / context->analogFrames;
+    float ticksPerPass = (float)gLoopLength / gFramesPerLfoTick;
+    set_lfo_phase(gLFO, gLfoSyncPhase + gLfoCurve.position() * gLFO->phase_inc);
+    gLfoCurve.beginRender(gLFO, gLfoSyncPhase, (unsigned int)(ticksPerPass + 0.5f));
+}
 
-    // Initialize the looper buffer to zero
-    gAudioBuffer.resize(gBufferSize, 0.0f);
+// Change the LFO shape at runtime, keeping the curve cache coherent
+void setLfoShape(unsigned int type)
+{
+    set_lfo_type(gLFO, type);
+    if(gLoopLength > 0 && gFramesPerLfoTick)
+        refreshLfoCurve();
+}
 
-    // Configure digital pins for buttons & LED
-    pinMode(context, 0, gButtonPin, INPUT);
-    pinMode(context, 0, gLEDPin, OUTPUT);
-    pinMode(context, 0, gClearButtonPin, INPUT);
+// Move the MORPH shape. The first move hands over from the cache to the
+// live oscillator, at the cursor; the curve is only re-rendered once the
+// morph has rested for LFO_MORPH_SETTLE (see settleLfoMorph()).
+static void setLfoMorph(float position)
+{
+    if(std::fabs(position - gLFO->morph_target) < 1e-3f)
+        return;
+    set_lfo_morph(gLFO, position);
+    if(gLFO->lfo_type != MORPH || gLoopLength == 0 || !gFramesPerLfoTick)
+        return;
+    if(!gLfoCurve.isHeld()) {
+        set_lfo_phase(gLFO, gLfoSyncPhase + gLfoCurve.position() * gLFO->phase_inc);
+        gLfoCurve.hold();
+    }
+    gLfoMorphSettle = (unsigned int)(LFO_MORPH_SETTLE * gLfoClockRate) + 1;
+}
 
-    // Initialize LFO at e.g. 0.1Hz or 1Hz
-    float fs = context->audioSampleRate;
-    gLFO = init_lfo(gLFO, 0.1f, fs, 0.0f); // frequency=0.1Hz for slow sweep
-    set_lfo_type(gLFO, SINE);
+// Once per LFO tick: re-render the curve when the morph has rested
+static void settleLfoMorph()
+{
+    if(gLfoMorphSettle == 0 || --gLfoMorphSettle > 0)
+        return;
+    if(gLoopLength > 0)
+        refreshLfoCurve();
+}
 
-    rt_printf("Looper + Delay + Overdub + LFO => (DelayTime + PlaybackSpeed)\n");
+// Check the loop slots written since the last call for NaN/Inf, which
+// overdubbing would otherwise keep forever, and zero the damaged part
+static void checkLoopWrites()
+{
+    int size = gLoopLength > 0 ? gLoopLength : gEngineConfig.maxLoopSamples;
+    int count = (gWritePointer - gLoopCheckStart + size) % size;
+    if(gLoopCheckStart < size && gAudioBuffer->scrub(gLoopCheckStart, count, size))
+        gNonFiniteEvents++;
+    gLoopCheckStart = gWritePointer;
+}
+
+// Close the loop at the current write position: fixes the loop length,
+// tempo-locks the LFO to it and restarts playback from the top.
+static void closeLoop(unsigned int n)
+{
+    checkLoopWrites();
+    gLoopLength = gWritePointer;
+    gTake++;
+    gFindLoopPoints = true;
+    gWritePointer = 0;
+    gLoopCheckStart = 0;
+    readIndex = 0.0f;
+    if(!gFramesPerLfoTick)
+        return;
+    lock_lfo_to_length(gLFO, (float)gLoopLength / gFramesPerLfoTick, gLfoCyclesPerLoop, gLfoClockRate);
+    retriggerLfo(n, n);
+    refreshLfoCurve();
+
+    // give back what the first take left past the end
+    gAudioBuffer->trim(gLoopLength);
+}
+
+// Repeat the loop `times` times, e.g. to overdub a longer phrase over it.
+// Zero-copy: the repeats reference the loop's chunks until they are
+// overdubbed. The play head stays where it is, in the first repeat.
+bool multiplyLoop(unsigned int times)
+{
+    if(gLoopLength == 0 || times < 2)
+        return false;
+    checkLoopWrites();
+    if(!gAudioBuffer->multiply(gLoopLength, times))
+        return false;
+    gLoopLength *= times;
+    gTake++;
+    gLoopCheckStart = gWritePointer;
+    if(!gFramesPerLfoTick)
+        return true;
+    lock_lfo_to_length(gLFO, (float)gLoopLength / gFramesPerLfoTick, gLfoCyclesPerLoop * times, gLfoClockRate);
+    refreshLfoCurve();
     return true;
 }
 
+// Auxiliary task: the job runner. Never runs in the audio thread.
+static void jobTask(void*)
+{
+    gJobs.runUntilIdle(JOB_SLICE_US, JOB_REST_US);
+}
+
+static void wakeJobTask(void*)
+{
+    Bela_scheduleAuxiliaryTask(gJobTask);
+}
+
+// Job: decode a bank into the spare buffer, then hand it to render()
+class BankRestoreJob : public Job {
+public:
+    unsigned int bank;
+    unsigned int pos;
+
+    bool step() override
+    {
+        gLoopBank.restoreSome(bank, *gSpareBuffer, pos, BANK_CHUNKS_PER_STEP);
+        if(pos < gLoopBank.length(bank))
+            return false;
+        gBankReadyLength = gLoopBank.length(bank);
+        // the playing copy lives in the buffer from now on
+        gLoopBank.discard(bank);
+        gBankReady.store(bank, std::memory_order_release);
+        return true;
+    }
+};
+
+// Job: compress the loop render() let go of, then empty its buffer
+class BankStoreJob : public Job {
+public:
+    unsigned int bank;
+    unsigned int length;
+    unsigned int pos;
+
+    bool step() override
+    {
+        if(!gLoopBank.storeSome(bank, *gSpareBuffer, length, pos, BANK_CHUNKS_PER_STEP))
+            rt_printf("Loop bank %u could not be stored\n", bank);
+        if(pos < length)
+            return false;
+        gSpareBuffer->clear();
+        return true;
+    }
+};
+
+// Job: search a freshly closed take for better loop points
+class LoopPointJob : public Job {
+public:
+    const LoopBuffer* buffer;
+
+    bool step() override
+    {
+        return gLoopPointFinder.step(*buffer);
+    }
+};
+
+// Job: correlate the captured calibration signal
+class LatencyJob : public Job {
+public:
+    bool step() override
+    {
+        gLatencyCalibrator.analyse();
+        return true;
+    }
+};
+
 // ------------------------------------------------------
-// Render is called each audio frame
-void render(BelaContext *context, void *userData)
+// Fast boot: setup() only prepares what the first block needs. The first
+// block starts a job that maps the rest of the loop pools (tens of MB),
+// one slab per step, and reports how long first sound and fully ready
+// took. Until then a take can use the first BOOT_READY_SAMPLES.
+#define BOOT_READY_SAMPLES (gRuntimeConfig.sampleRate * 4)
+bool gBooted = false;           // render() only
+double gBootUptime = 0.0;       // seconds since power-on, at setup()
+double gProcessAge = -1.0;      // seconds since start-up, at setup(), if known
+double gSetupStart = 0.0;       // monotonic seconds
+double gSetupEnd = 0.0;
+double gFirstSound = 0.0;       // published by enqueueing the boot job
+
+static double monotonicSeconds()
 {
-    for(unsigned int n = 0; n < context->audioFrames; n++)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// How long ago this process started, from its start time in clock ticks
+// since boot (field 22 of /proc/self/stat); -1 if unavailable
+static double processAge(double uptime)
+{
+    FILE* f = fopen("/proc/self/stat", "r");
+    if(!f)
+        return -1.0;
+    char line[1024];
+    size_t n = fread(line, 1, sizeof(line) - 1, f);
+    fclose(f);
+    line[n] = 0;
+    // the command name can hold spaces: count fields from its ')'
+    const char* p = strrchr(line, ')');
+    unsigned long long start = 0;
+    if(!p || sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu", &start) != 1)
+        return -1.0;
+    return uptime - (double)start / sysconf(_SC_CLK_TCK);
+}
+
+// Job: map the loop pools, then report the boot times
+class BootJob : public Job {
+public:
+    bool step() override
     {
-        // Every gAudioFramesPerAnalogFrame frames, read the analog knobs
-        if(gAudioFramesPerAnalogFrame && !(n % gAudioFramesPerAnalogFrame))
-        {
-            // (1) Delay Mix
-            float analogMix = analogRead(context, n / gAudioFramesPerAnalogFrame, gAnalogDelayMixChannel);
-            delayEffect.setMix(analogMix);
+        // the playing buffer first; it is also the one render() starts with
+        for(LoopBuffer& buffer : gLoopBuffers) {
+            if(!buffer.poolReady()) {
+                buffer.grow(LOOP_SLAB_CHUNKS);
+                return false;
+            }
+        }
+        double ready = monotonicSeconds();
+        char sinceStart[48] = "";
+        if(gProcessAge >= 0.0)
+            snprintf(sinceStart, sizeof(sinceStart), ", %.0f ms after start-up", 1e3 * (gProcessAge + gFirstSound - gSetupStart));
+        rt_printf("Boot: first sound %.2f s after power-on%s (setup %.1f ms); fully ready %.0f ms later\n",
+                  gBootUptime + (gFirstSound - gSetupStart), sinceStart,
+                  1e3 * (gSetupEnd - gSetupStart), 1e3 * (ready - gFirstSound));
+        return true;
+    }
+};
 
-            // (2) Delay Feedback
-            float analogFb = analogRead(context, n / gAudioFramesPerAnalogFrame, gAnalogFeedbackChannel);
-            delayEffect.setFeedback(analogFb);
+// Job: analyse whatever the taps have, a frame of each per step
+class SpectrumJob : public Job {
+public:
+    bool step() override
+    {
+        bool in = gInputSpectrum.analyseNext();
+        bool out = gOutputSpectrum.analyseNext();
+        return !in && !out;
+    }
+};
+
+BankRestoreJob gBankRestoreJob;
+BankStoreJob gBankStoreJob;
+LatencyJob gLatencyJob;
+BootJob gBootJob;
+SpectrumJob gSpectrumJob;
+LoopPointJob gLoopPointJob;
+
+// The newest smoothed spectra, SPECTRUM_BINS values in dB; one reader
+// thread each, and the pointer is valid until that reader's next call
+const float* inputSpectrum()
+{
+    return gInputSpectrum.latest();
+}
 
-            // (3) Playback Speed => [-2..+2]
-            float speedVal = analogRead(context, n / gAudioFramesPerAnalogFrame, gAnalogSpeedChannel);
-            gPlaybackSpeed = -2.0f + speedVal * 4.0f; 
+const float* outputSpectrum()
+{
+    return gOutputSpectrum.latest();
+}
 
-            // (4) LFO Depth => how strongly LFO modulates delay time
-            float lfoDepth = analogRead(context, n / gAudioFramesPerAnalogFrame, gAnalogLfoDepthChannel);
-            if(lfoDepth < 0.0f) lfoDepth = 0.0f;
-            if(lfoDepth > 1.0f) lfoDepth = 1.0f;
+// Switch playback to another stored loop; the current one is compressed
+// into its bank. Takes effect a few blocks later, from the loop start.
+// Refused while recording, while the previous switch is still compressing
+// (both need the spare buffer), and at boot until the spare buffer is
+// mapped.
+bool selectLoopBank(unsigned int bank)
+{
+    if(bank >= LOOP_BANKS || bank == gActiveBank || gBankSwitching || gBankStoreJob.busy()
+       || gRecording || !gSpareBuffer->poolReady())
+        return false;
+    gBankSwitching = true;
+    gBankRestoreJob.bank = bank;
+    gBankRestoreJob.pos = 0;
+    gJobs.enqueue(gBankRestoreJob, JOB_HIGH);
+    return true;
+}
 
-            // Run LFO, returns ~[0..1]
-            float lfoVal = run_lfo(gLFO);
+// Block start: take over a decoded loop if one is waiting. The only cost
+// to render() while no switch is pending is the one atomic load. A take or
+// overdub started since the switch was asked for keeps its buffer until
+// it is stopped.
+static void finishBankSwitch()
+{
+    int ready = gBankReady.load(std::memory_order_acquire);
+    if(ready < 0 || gRecording)
+        return;
+    gBankReady.store(-1, std::memory_order_relaxed);
+
+    checkLoopWrites();
+    gAudioBuffer->endBlock();
+    std::swap(gAudioBuffer, gSpareBuffer);
+    gBankStoreJob.bank = gActiveBank;
+    gBankStoreJob.length = gLoopLength;
+    gBankStoreJob.pos = 0;
+    gJobs.enqueue(gBankStoreJob, JOB_NORMAL);
+
+    gActiveBank = ready;
+    gTake++;
+    gBankSwitching = false;
+    gLoopLength = gBankReadyLength;
+    gWritePointer = 0;
+    gLoopCheckStart = 0;
+    readIndex = 0.0f;
+    if(gLoopLength == 0 || !gFramesPerLfoTick) {
+        gLfoCurve.invalidate();
+        return;
+    }
+    lock_lfo_to_length(gLFO, (float)gLoopLength / gFramesPerLfoTick, gLfoCyclesPerLoop, gLfoClockRate);
+    retriggerLfo(0, 0);
+    refreshLfoCurve();
+}
 
-            // Map LFO output [0..1] => [-1..+1]
-            float mod = (lfoVal - 0.5f) * 2.0f;
+// Block start: move to refined loop points if a search has found some for
+// the take still playing. Playback carries on at the same material.
+static void applyLoopPoints()
+{
+    int take = gLoopPointFinder.ready();
+    if(take < 0)
+        return;
+    gLoopPointFinder.consume();
+    unsigned int start = gLoopPointFinder.loopStart();
+    unsigned int length = gLoopPointFinder.loopLength();
+    if(take != gTake || gRecording || !gAudioBuffer->setStart(start))
+        return;
+    rt_printf("Loop points: start %u, length %d -> %u (correlation %.2f)\n",
+              start, gLoopLength, length, gLoopPointFinder.confidence());
+
+    readIndex = fmodf(readIndex - start, (float)length);
+    if(readIndex < 0.0f)
+        readIndex += length;
+    gLoopLength = length;
+    gWritePointer = 0;
+    gLoopCheckStart = 0;
+    gTake++;
+    gAudioBuffer->trim(gLoopLength);
+    if(!gFramesPerLfoTick)
+        return;
+    lock_lfo_to_length(gLFO, (float)gLoopLength / gFramesPerLfoTick, gLfoCyclesPerLoop, gLfoClockRate);
+    refreshLfoCurve();
+}
 
-            // We want e.g. base=0.1s, maxDelta=1.9 => final range [0.1-1.9..0.1+1.9] => [~0.0..2.0]
-            // We'll clamp to [0.01..2.0] in case it goes beyond
-            float baseDelaySec  = 0.1f;   // baseline
-            float maxDelta      = 1.9f;   // how far above/below base we can go
+// Play the test signal instead of the looper until it has been captured,
+// then hand the analysis to the auxiliary task and apply its result.
+// Returns true while the calibration owns the outputs.
+static bool runLatencyCalibration(BelaContext *context)
+{
+    if(!gLatencyPending)
+        return false;
+    if(gLatencyCalibrator.processBlock(gInputBlock.data(), gCalibrationOut.data(), context->audioFrames))
+    {
+        for(unsigned int n = 0; n < context->audioFrames; n++)
+            for(unsigned int channel = 0; channel < context->audioOutChannels; channel++)
+                audioWrite(context, n, channel, gCalibrationOut[n]);
+        if(gLatencyCalibrator.state() == LatencyCalibrator::CAPTURED)
+            gJobs.enqueue(gLatencyJob, JOB_HIGH);
+        return true;
+    }
 
-            // Then the actual offset = mod * maxDelta * lfoDepth => [-1.9..+1.9]*lfoDepth
-            float offset = mod * maxDelta * lfoDepth;
-            float newDelayTime = baseDelaySec + offset; // might be from ~(-1.8) up to 2.0 or so
+    LatencyCalibrator::State state = gLatencyCalibrator.state();
+    if(state == LatencyCalibrator::DONE)
+    {
+        gOverdubOffset = gLatencyCalibrator.latency();
+        rt_printf("Round-trip latency: %d samples (confidence %.1f)\n", gOverdubOffset, gLatencyCalibrator.confidence());
+        gLatencyPending = false;
+    }
+    else if(state == LatencyCalibrator::FAILED)
+    {
+        rt_printf("Latency calibration failed (confidence %.1f), keeping %d samples\n",
+                  gLatencyCalibrator.confidence(), gOverdubOffset);
+        gLatencyPending = false;
+    }
+    return false;
+}
 
-            // clamp [0.01..2.0]
-            if(newDelayTime < 0.01f) newDelayTime = 0.01f;
-            if(newDelayTime > 2.0f)  newDelayTime = 2.0f;
+// ------------------------------------------------------
+// Setup runs once before audio processing begins
+bool setup(BelaContext *context, void *userData)
+{
+    timespec uptime;
+    clock_gettime(CLOCK_BOOTTIME, &uptime);
+    gSetupStart = monotonicSeconds();
+    gBootUptime = uptime.tv_sec + 1e-9 * uptime.tv_nsec;
+    gProcessAge = processAge(gBootUptime);
+    gBooted = false;
 
-            // Apply to DelayEffect
-            delayEffect.setDelayTime(newDelayTime);
-        }
+    // Determine ratio of audioFrames to analogFrames
+    if(context->analogFrames)
+        gAudioFramesPerAnalogFrame = context->audioFrames / context->analogFrames;
 
-        // Read the audio input
-        float in = audioRead(context, n, 0);
+    // Run the kernels specialised for this build's profile if Bela runs at
+    // its rate, block size and channels; otherwise the generic ones, with
+    // what it does run at
+    gRuntimeConfig = gEngineConfig;
+    gRuntimeConfig.sampleRate = (unsigned int)context->audioSampleRate;
+    gRuntimeConfig.blockSize = context->audioFrames;
+    gRuntimeConfig.channels = context->audioOutChannels;
+    gSpecialised = engineConfigMatches(gEngineConfig, context->audioSampleRate, context->audioFrames, context->audioOutChannels);
+    if(!gSpecialised)
+        rt_printf("Engine built for %u Hz, -p %u, %u outputs; running generic at %u Hz, -p %u, %u outputs\n",
+                  gEngineConfig.sampleRate, gEngineConfig.blockSize, gEngineConfig.channels,
+                  gRuntimeConfig.sampleRate, gRuntimeConfig.blockSize, gRuntimeConfig.channels);
+    gInputStage = InputStage(context->audioSampleRate);
+    gEnvelope = EnvelopeFollower(context->audioSampleRate);
+    delayEffect.setSampleRate(gRuntimeConfig.sampleRate);
+
+    // The looper buffers, with room for a full take to be multiplied
+    // (repeats start on chunk boundaries). Only the start of the playing
+    // one's pool is mapped now; the boot job maps the rest.
+    const unsigned int logical = (gEngineConfig.maxLoopSamples + LOOP_CHUNK_SIZE) * gEngineConfig.maxMultiple;
+    gAudioBuffer->resize(logical, gEngineConfig.poolSamples, BOOT_READY_SAMPLES);
+    gSpareBuffer->resize(logical, gEngineConfig.poolSamples, 0);
+    gLoopBank.resize(LOOP_BANKS, gEngineConfig.storage);
+    gJobTask = Bela_createAuxiliaryTask(jobTask, BELA_AUDIO_PRIORITY - 30, "loopy-jobs");
+    gJobs.setWakeup(wakeJobTask, nullptr);
+
+    // Latency calibration, searching round trips up to ~46ms
+    gLatencyCalibrator.setup(2048);
+    gCalibrationOut.resize(context->audioFrames, 0.0f);
+    gInputBlock.resize(context->audioFrames, 0.0f);
+    gOutputBlock.resize(context->audioFrames, 0.0f);
+    gLoopPointFinder.setup(LOOP_POINT_SEARCH, LOOP_POINT_WINDOW, LOOP_POINT_BUDGET);
+    gInputTap.resize(SPECTRUM_TAP_SIZE);
+    gOutputTap.resize(SPECTRUM_TAP_SIZE);
+    gInputSpectrum.setup(&gInputTap, SPECTRUM_HOP, context->audioSampleRate);
+    gOutputSpectrum.setup(&gOutputTap, SPECTRUM_HOP, context->audioSampleRate);
+    gOutputChain.start(context->audioFrames, context->audioSampleRate, gPipelineWorkers);
+
+    // Darken the repeats like a tape/analog delay
+    delayEffect.setDamping(5000.0f, 60.0f);
+
+    // and keep high feedback from running away: soft clip at 4x oversampling.
+    // 2x still folds the 5th harmonic back at -20 dB (bench sat); 4x keeps
+    // the total alias to -44 dB for under 1% of a -p 8 block.
+    delayEffect.setSaturation(1.0f, 4);
+
+    // Configure digital pins for buttons & LED
+    pinMode(context, 0, gEngineConfig.recordPin, INPUT);
+    pinMode(context, 0, gEngineConfig.ledPin, OUTPUT);
+    pinMode(context, 0, gEngineConfig.clearPin, INPUT);
+
+    // Default routing, the knob layout described at the top:
+    //   mix = knob0, feedback = knob1, speed = -2 + 4 * knob3,
+    //   delay time = 0.1s + 1.9s * LFO * knob2, within [0.01..2.0]
+    gModMatrix.setRange(MOD_DST_DELAY_TIME, 0.1f, 0.01f, 2.0f);
+    gModMatrix.setRange(MOD_DST_FEEDBACK, 0.0f, 0.0f, 1.0f);
+    gModMatrix.setRange(MOD_DST_MIX, 0.0f, 0.0f, 1.0f);
+    gModMatrix.setRange(MOD_DST_SPEED, -2.0f, -2.0f, 2.0f);
+    gModMatrix.setRange(MOD_DST_LFO_MORPH, 0.0f, 0.0f, 3.0f);
+    gModMatrix.setRoute(MOD_SRC_KNOB0, MOD_DST_MIX, 1.0f);
+    gModMatrix.setRoute(MOD_SRC_KNOB1, MOD_DST_FEEDBACK, 1.0f);
+    gModMatrix.setRoute(MOD_SRC_KNOB3, MOD_DST_SPEED, 4.0f);
+    gModMatrix.setRoute(MOD_SRC_LFO, MOD_DST_DELAY_TIME, 1.9f, MOD_SRC_KNOB2);
+
+    // Initialize LFO at e.g. 0.1Hz or 1Hz, clocked once per block
+    gFramesPerLfoTick = context->audioFrames;
+    if(gFramesPerLfoTick)
+        gLfoClockRate = context->audioSampleRate / gFramesPerLfoTick;
+    gLFO = init_lfo(gLFO, 0.1f, gLfoClockRate, 0.0f); // frequency=0.1Hz for slow sweep
+    set_lfo_type(gLFO, SINE);
+
+    rt_printf("Looper + Delay + Overdub + LFO => (DelayTime + PlaybackSpeed)\n");
+    gSetupEnd = monotonicSeconds();
+    return true;
+}
+
+// ------------------------------------------------------
+// One block, for an engine config: with gEngineConfig every size, count
+// and channel below is a constant
+template <const EngineConfig& Config>
+static void renderBlock(BelaContext *context)
+{
+    if(!gBooted)
+    {
+        gBooted = true;
+        gFirstSound = monotonicSeconds();
+        gJobs.enqueue(gBootJob, JOB_NORMAL);
+    }
+    finishBankSwitch();
+    applyLoopPoints();
+
+    // Spread the rendering of a new LFO curve over many blocks
+    settleLfoMorph();
+    gLfoCurve.renderSome(gLfoCurveTicksPerBlock);
+    delayEffect.beginBlock();
+
+    // Condition the whole mic block up front; false means the gate is shut
+    for(unsigned int n = 0; n < Config.blockSize; n++)
+        gInputBlock[n] = audioRead(context, n, 0);
+    gInputTap.push(gInputBlock.data(), Config.blockSize);
+    if(runLatencyCalibration(context))
+        return;
+    bool inputActive = gInputStage.processBlock(gInputBlock.data(), Config.blockSize);
+    gEnvelope.processBlock(gInputBlock.data(), Config.blockSize);
+
+    // Control rate: sources in, matrix once, ramps out over this block
+    if(context->analogFrames)
+    {
+        gModMatrix.setSource(MOD_SRC_KNOB0, analogRead(context, 0, Config.mixChannel));
+        gModMatrix.setSource(MOD_SRC_KNOB1, analogRead(context, 0, Config.feedbackChannel));
+        gModMatrix.setSource(MOD_SRC_KNOB2, analogRead(context, 0, Config.lfoDepthChannel));
+        gModMatrix.setSource(MOD_SRC_KNOB3, analogRead(context, 0, Config.speedChannel));
+    }
+
+    // Run LFO, returns ~[0..1]; replayed from the cache when ready
+    float lfoVal;
+    if(!gLfoCurve.next(lfoVal))
+        lfoVal = run_lfo(gLFO);
+    gModMatrix.setSource(MOD_SRC_LFO, (lfoVal - 0.5f) * 2.0f);
+    gModMatrix.setSource(MOD_SRC_ENVELOPE, gEnvelope.value());
+    gModMatrix.evaluate();
+
+    delayEffect.setDelayTime(gModMatrix.get(MOD_DST_DELAY_TIME)); // smoothed internally
+    delayEffect.rampFeedback(gModMatrix.get(MOD_DST_FEEDBACK), Config.blockSize);
+    delayEffect.rampMix(gModMatrix.get(MOD_DST_MIX), Config.blockSize);
+    float speedStep = (gModMatrix.get(MOD_DST_SPEED) - gPlaybackSpeed) / Config.blockSize;
+    setLfoMorph(gModMatrix.get(MOD_DST_LFO_MORPH)); // heard from the next tick
+
+    // Overdubs go through a write span of the loop, opened when the first
+    // sample needs it and again only where it ends (a chunk boundary) or
+    // the write pointer jumps
+    float* overdub = nullptr;
+    unsigned int overdubLeft = 0;
+
+    for(unsigned int n = 0; n < Config.blockSize; n++)
+    {
+        // Conditioned audio input
+        float in = gInputBlock[n];
 
         // Check buttons
-        int buttonState      = digitalRead(context, n, gButtonPin);
-        int clearButtonState = digitalRead(context, n, gClearButtonPin);
+        int buttonState      = digitalRead(context, n, Config.recordPin);
+        int clearButtonState = digitalRead(context, n, Config.clearPin);
 
         // (A) Record/Play toggle
-        static int localLastButtonState = 0;
-        if(buttonState == 1 && localLastButtonState == 0)
+        if(buttonState == 1 && gLastButtonState == 0)
         {
             if(gRecording)
             {
                 gRecording = false;
                 gPlaying   = true;
-                digitalWrite(context, n, gLEDPin, LOW);
+                if(gLoopLength == 0 && gWritePointer > 0)
+                    closeLoop(n);
+                digitalWrite(context, n, Config.ledPin, LOW);
+            }
+            else if(clearButtonState == 1)
+            {
+                // Record while Clear is held: calibrate the latency. The
+                // loop is kept, and plays on once the calibration is done.
+                gClearPending = false;
+                gLatencyCalibrator.start();
+                gLatencyPending = true;
             }
             else
             {
+                // Overdubs follow the play head once a loop exists, one
+                // round trip behind it
+                if(gLoopLength > 0)
+                    gWritePointer = ((int)readIndex - gOverdubOffset % gLoopLength + gLoopLength) % gLoopLength;
+                gLoopCheckStart = gWritePointer;
+                overdubLeft = 0;
+                gTake++;
                 gRecording = true;
                 gPlaying   = true;
-                digitalWrite(context, n, gLEDPin, HIGH);
+                digitalWrite(context, n, Config.ledPin, HIGH);
             }
         }
-        localLastButtonState = buttonState;
+        gLastButtonState = buttonState;
 
-        // (B) Clear buffer
-        static int localLastClearButtonState = 0;
-        if(clearButtonState == 1 && localLastClearButtonState == 0)
+        // (B) Clear buffer, when released: Record pressed while it is held
+        // calibrates instead (see above)
+        if(clearButtonState == 1 && gLastClearButtonState == 0)
+            gClearPending = true;
+        if(clearButtonState == 0 && gLastClearButtonState == 1 && gClearPending)
         {
-            if(!gClearedOnce)
-            {
-                std::fill(gAudioBuffer.begin(), gAudioBuffer.end(), 0.0f);
-                gWritePointer = 0;
-                gReadPointer  = 0;
-                readIndex     = 0.0f;
-                gRecording    = false;
-                gPlaying      = false;
-                digitalWrite(context, n, gLEDPin, LOW);
-                gClearedOnce  = true;
-            }
-        }
-        if(clearButtonState == 0 && localLastClearButtonState == 1)
-        {
-            gClearedOnce = false;
+            gAudioBuffer->clear();
+            overdubLeft   = 0;
+            gLoopLength   = 0;
+            gTake++;
+            gLfoCurve.invalidate();
+            gWritePointer = 0;
+            gLoopCheckStart = 0;
+            gReadPointer  = 0;
+            readIndex     = 0.0f;
+            gRecording    = false;
+            gPlaying      = false;
+            digitalWrite(context, n, Config.ledPin, LOW);
+            gClearPending = false;
         }
-        localLastClearButtonState = clearButtonState;
+        gLastClearButtonState = clearButtonState;
 
         // Processing: rec or play
         float out = 0.0f;
+        int loopLength = gLoopLength > 0 ? gLoopLength : Config.maxLoopSamples;
 
-        // If Recording => pass input through DelayEffect => Overdub
-        if(gRecording)
+        // If Recording => pass input through DelayEffect => Overdub.
+        // With the gate shut and the repeats died away there is nothing
+        // to monitor or to add to the loop, so only the pointer moves.
+        if(gRecording && !inputActive && delayEffect.isIdle())
+        {
+            gWritePointer++;
+            overdubLeft = 0;
+        }
+        else if(gRecording)
         {
-            float processedIn = delayEffect.processSample(in);
+            float processedIn = delayEffect.processSample<gEngineConfig.delaySamples>(in);
             out += processedIn; // real-time monitor
-            gAudioBuffer[gWritePointer] += (processedIn * 0.75f);
-            gWritePointer = (gWritePointer + 1) % gBufferSize;
+            if(overdubLeft == 0)
+            {
+                overdubLeft = Config.blockSize - n;
+                overdub = gAudioBuffer->writeSpan(gWritePointer, overdubLeft);
+            }
+            *overdub++ += processedIn * 0.75f;
+            overdubLeft--;
+            gWritePointer++;
+        }
+        if(gRecording && gWritePointer >= loopLength)
+        {
+            overdubLeft = 0;
+            if(gLoopLength > 0)
+            {
+                gWritePointer = 0; // overdubs go round the loop
+            }
+            else
+            {
+                // A first take that fills the buffer closes the loop there,
+                // instead of wrapping onto its own start
+                gRecording = false;
+                gPlaying   = true;
+                closeLoop(n);
+                digitalWrite(context, n, Config.ledPin, LOW);
+            }
         }
 
         // If Playing => read from loop buffer
         if(gPlaying)
         {
-            float playSample = gAudioBuffer[(int)readIndex % gBufferSize];
+            float speed = gPlaybackSpeed;
+
+            float playSample = gAudioBuffer->read((int)readIndex % loopLength);
             out += playSample;
 
-            // update readIndex by gPlaybackSpeed
-            readIndex += gPlaybackSpeed;
+            // update readIndex by the speed, retriggering the LFO
+            // whenever the play head wraps around the loop
+            readIndex += speed;
             if(readIndex < 0)
-                readIndex += gBufferSize;
-            else if(readIndex >= gBufferSize)
-                readIndex -= gBufferSize;
+            {
+                readIndex += loopLength;
+                if(gLoopLength > 0)
+                    retriggerLfo(n, n + 1 - (loopLength - readIndex) / -speed);
+            }
+            else if(readIndex >= loopLength)
+            {
+                readIndex -= loopLength;
+                if(gLoopLength > 0)
+                    retriggerLfo(n, n + 1 - readIndex / speed);
+            }
         }
 
-        // Output final to both channels
-        for(unsigned int channel = 0; channel < context->audioOutChannels; channel++)
+        // ramp the speed towards this block's target
+        gPlaybackSpeed += speedStep;
+
+        gOutputBlock[n] = out;
+    }
+
+    // Output chain, then final to both channels
+    if(gOutputChain.numStages())
+        gOutputChain.process(gOutputBlock.data(), Config.blockSize);
+    for(unsigned int n = 0; n < Config.blockSize; n++)
+    {
+        for(unsigned int channel = 0; channel < Config.channels; channel++)
+            audioWrite(context, n, channel, gOutputBlock[n]);
+    }
+
+    // Spectrum taps: the copies are all render() does for them
+    gOutputTap.push(gOutputBlock.data(), Config.blockSize);
+    gSpectrumFrames += Config.blockSize;
+    if(gSpectrumFrames >= SPECTRUM_HOP && gJobs.enqueue(gSpectrumJob, JOB_LOW))
+        gSpectrumFrames = 0;
+
+    // NaN/Inf guard for this block's overdubs (the delay checks its own
+    // buffer in beginBlock()), then publish them to readers. New events
+    // are reported from here, rarely.
+    checkLoopWrites();
+    gAudioBuffer->endBlock();
+
+    // A take closed in this block, now published: look for better loop
+    // points
+    if(gFindLoopPoints)
+    {
+        gFindLoopPoints = false;
+        if(gLoopPointFinder.start(gLoopLength, gTake))
         {
-            audioWrite(context, n, channel, out);
+            gLoopPointJob.buffer = gAudioBuffer;
+            gJobs.enqueue(gLoopPointJob, JOB_HIGH);
         }
     }
+    unsigned int events = gNonFiniteEvents + delayEffect.recoveries();
+    if(events != gReportedNonFiniteEvents)
+    {
+        rt_printf("Cleared NaN/Inf from feedback buffers (%u events)\n", events);
+        gReportedNonFiniteEvents = events;
+    }
+}
+
+// ------------------------------------------------------
+// Render is called each audio frame
+void render(BelaContext *context, void *userData)
+{
+    if(gSpecialised)
+        renderBlock<gEngineConfig>(context);
+    else
+        renderBlock<gRuntimeConfig>(context);
 }
 
 // ------------------------------------------------------
 // Cleanup runs once after audio has stopped
 void cleanup(BelaContext *context, void *userData)
 {
+    // the split is gone once stopped: report it first
+    for(unsigned int i = 0; i < gOutputChain.numStages(); i++)
+        rt_printf("Output stage %-16s worker %u, %.0f ns/block\n", gOutputChain.stageName(i),
+                  gOutputChain.stageWorker(i), gOutputChain.stageCost(i));
+    for(unsigned int w = 0; w < gOutputChain.numWorkers(); w++)
+        rt_printf("Output worker %u load %.0f%%\n", w, 100.0f * gOutputChain.workerLoad(w));
+    gOutputChain.stop();
+    if(gOutputChain.underruns())
+        rt_printf("Output chain missed %u blocks\n", gOutputChain.underruns());
+    rt_printf("Background jobs: %u done in %u steps, longest step %.0f us\n",
+              gJobs.completed(), gJobs.steps(), gJobs.longestStep());
+    rt_printf("Spectrum frames: %u input, %u output (%u and %u skipped)\n",
+              gInputSpectrum.framesAnalysed(), gOutputSpectrum.framesAnalysed(),
+              gInputSpectrum.framesSkipped(), gOutputSpectrum.framesSkipped());
     rt_printf("Looper cleanup done.\n");
     // e.g. if LFO allocated with malloc, free(gLFO);
     // free(gLFO);
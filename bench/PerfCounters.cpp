@@ -0,0 +1,150 @@
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static uint64_t cacheEvent(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static int openEvent(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+static double nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+PerfCounters::PerfCounters()
+    : firstErrno(0)
+    , started(0.0)
+    , elapsed(0.0)
+{
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        fds[e] = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        if(fds[e] >= 0)
+            close(fds[e]);
+#endif
+}
+
+bool PerfCounters::open()
+{
+#ifdef __linux__
+    static const struct { uint32_t type; uint64_t config; } events[PERF_NUM_EVENTS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D) },
+        { PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB) },
+    };
+    for(int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if(fds[e] < 0)
+            fds[e] = openEvent(events[e].type, events[e].config);
+        if(fds[e] < 0 && !firstErrno)
+            firstErrno = errno;
+    }
+#else
+    firstErrno = ENOSYS;
+#endif
+    return anyAvailable();
+}
+
+bool PerfCounters::anyAvailable() const
+{
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        if(fds[e] >= 0)
+            return true;
+    return false;
+}
+
+const char* PerfCounters::error() const
+{
+    if(firstErrno == EACCES || firstErrno == EPERM)
+        return "not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+    if(firstErrno == ENOENT || firstErrno == EOPNOTSUPP || firstErrno == ENODEV)
+        return "no hardware PMU";
+    return firstErrno ? strerror(firstErrno) : "";
+}
+
+const char* PerfCounters::name(PerfEvent event)
+{
+    static const char* names[PERF_NUM_EVENTS] = {
+        "cycles", "instr", "L1d miss", "LL miss", "br miss", "dTLB miss"
+    };
+    return names[event];
+}
+
+void PerfCounters::reset()
+{
+    elapsed = 0.0;
+#ifdef __linux__
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        if(fds[e] >= 0)
+            ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+#endif
+}
+
+void PerfCounters::start()
+{
+#ifdef __linux__
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        if(fds[e] >= 0)
+            ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    started = nowNs();
+}
+
+void PerfCounters::stop()
+{
+    elapsed += nowNs() - started;
+#ifdef __linux__
+    // in reverse, so each event brackets the work as evenly as it can
+    for(int e = PERF_NUM_EVENTS - 1; e >= 0; e--)
+        if(fds[e] >= 0)
+            ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+}
+
+double PerfCounters::value(PerfEvent event) const
+{
+#ifdef __linux__
+    uint64_t v[3];   // value, time enabled, time running
+    if(fds[event] < 0 || read(fds[event], v, sizeof(v)) != (ssize_t)sizeof(v))
+        return -1.0;
+    if(v[2] == 0)
+        return v[1] ? -1.0 : 0.0;   // enabled but never scheduled
+    return (double)v[0] * v[1] / v[2];
+#else
+    (void)event;
+    return -1.0;
+#endif
+}
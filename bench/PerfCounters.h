@@ -0,0 +1,60 @@
+/*
+  PerfCounters.h: hardware performance counters for the host benchmark and
+  simulator, through Linux perf_event_open.
+
+  Each event is opened on its own rather than as a group: the PMU of the
+  board (and of many desktops) has fewer counters than there are events
+  here, so the kernel multiplexes them and values are scaled by the share
+  of the time each was counting. Only user-space work of the calling
+  thread is counted, which also keeps the enable/disable system calls out
+  of the figures and works at perf_event_paranoid 2.
+
+  Where an event, or perf_event_open itself, is not available (a VM
+  without a virtual PMU, a kernel built without perf, not Linux) it reads
+  as missing and the caller prints timing only.
+*/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,        // L1 data cache read misses
+    PERF_LL_MISSES,         // last-level (L2 on the board) read misses
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,       // data TLB read misses
+    PERF_NUM_EVENTS
+};
+
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    // Open what the machine has; false if no event could be opened
+    bool open();
+    bool available(PerfEvent event) const { return fds[event] >= 0; }
+    bool anyAvailable() const;
+    // Why the first event could not be opened, for the report
+    const char* error() const;
+    static const char* name(PerfEvent event);
+
+    // Counting accumulates over start()/stop() pairs until reset()
+    void reset();
+    void start();
+    void stop();
+
+    // Count since reset(), scaled for multiplexing; -1 if not available
+    double value(PerfEvent event) const;
+    // Wall time between the starts and stops since reset(), always there
+    double elapsedNs() const { return elapsed; }
+
+private:
+    int fds[PERF_NUM_EVENTS];
+    int firstErrno;
+    double started;
+    double elapsed;
+};
+
+#endif
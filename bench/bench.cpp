@@ -0,0 +1,1352 @@
+/*
+  bench.cpp: host benchmark harness for the Loopy DSP code.
+
+  Builds with ./build.sh and runs standalone on a desktop machine; nothing
+  here is part of the Bela project. Each section prints one line per
+  kernel. Timings are ns per sample and use the best of several runs to
+  filter out scheduler noise.
+
+  Sections:
+    math    - FastMath.h against libm: max ulp error and speed
+    filters - BiquadBank cascade/parallel against scalar biquads, the
+              cost of feedback damping in DelayEffect and of its buffer
+              size known only at run time, and InputStage
+    lfo     - run_lfo() per shape, and the vectorised RandomLfoBank
+    sat     - oversampled feedback saturation: aliasing, cost per sample
+              and share of a -p 8 block (8 frames at 44.1kHz)
+    loop    - LoopBuffer: overdub cost against a plain vector, multiplying
+              a 20s loop (time and pool memory), a concurrent reader
+              checked for torn blocks, and pool setup at boot
+    codec   - lossless loop codec: ratio and speed on several signals,
+              and storing/restoring a 20s loop through LoopBank
+    pipeline - a chain of heavy stages run inline and pipelined across 1,
+              2 and 4 workers: throughput, stage split and worker load
+    jobs    - JobScheduler: enqueue and step overhead, a bank store in
+              steps against one call, and how long a high-priority job
+              waits behind a backlog on a host runner thread
+    spectrum - Fft against a direct DFT and its speed, the audio-thread
+              cost of an AudioTap push, a concurrent tap reader checked
+              for torn frames, and the analyser's reading of a sine
+    interp  - the Interpolation.h readers: THD+N, spurious tones,
+              aliasing when sped up and cost at several speeds, modulation sidebands at several delay
+              modulation depths, error against an ideal fractional
+              delay, and the Pareto front
+              of cost against quality with the cheapest for each bar
+    counters - hardware counters per sample (PerfCounters.h) for
+              DelayEffect, the LFOs and loop playback at several speeds;
+              timing only where the machine has no counters. render() as
+              a whole is counted by loopy_sim profile.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <time.h>
+#include "FastMath.h"
+#include "Biquad.h"
+#include "DelayEffect.h"
+#include "InputStage.h"
+#include "lfo.h"
+#include "RandomLfoBank.h"
+#include "Saturator.h"
+#include "LoopBuffer.h"
+#include "LoopCodec.h"
+#include "LoopBank.h"
+#include "Pipeline.h"
+#include "JobScheduler.h"
+#include "Fft.h"
+#include "SpectrumAnalyser.h"
+#include "Interpolation.h"
+#include "PerfCounters.h"
+
+static double nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Best-of-`runs` time per element of fn(), which processes `n` elements
+template <typename F>
+static double timePerElement(unsigned int n, F fn, int runs = 7)
+{
+    double best = 1e30;
+    for(int r = 0; r < runs; r++) {
+        double t0 = nowNs();
+        fn();
+        double t = nowNs() - t0;
+        if(t < best)
+            best = t;
+    }
+    return best / n;
+}
+
+static volatile float gSink; // keeps timed results alive
+
+// ------------------------------------------------------
+// math: accuracy and speed of FastMath.h
+
+// Error of `got` in units in the last place of the correctly rounded result
+static double ulpError(float got, double ref)
+{
+    float r = (float)ref;
+    float ulp = std::nextafter(std::fabs(r), INFINITY) - std::fabs(r);
+    if(ulp == 0.f || !std::isfinite(ulp))
+        return 0.0;
+    return std::fabs((double)got - ref) / ulp;
+}
+
+struct MathCase {
+    const char* name;
+    float lo, hi;
+    bool logSpaced;
+    double (*ref)(double);
+    float (*libm)(float);
+    float (*scalar)(float);
+    void (*block)(float*, const float*, unsigned int);
+};
+
+static void runMath()
+{
+    static const MathCase cases[] = {
+        { "floor", -1e6f, 1e6f, false,
+          [](double x) { return std::floor(x); }, [](float x) { return std::floor(x); },
+          [](float x) { return fast_floor(x); },
+          [](float* o, const float* i, unsigned int n) { fast_map(o, i, n, [](auto v) { return fast_floor(v); }); } },
+        { "exp2", -126.f, 126.f, false,
+          [](double x) { return std::exp2(x); }, [](float x) { return std::exp2(x); },
+          [](float x) { return fast_exp2(x); }, fast_exp2_block },
+        { "exp", -87.f, 87.f, false,
+          [](double x) { return std::exp(x); }, [](float x) { return std::exp(x); },
+          [](float x) { return fast_exp(x); },
+          [](float* o, const float* i, unsigned int n) { fast_map(o, i, n, [](auto v) { return fast_exp(v); }); } },
+        { "log2", 0.25f, 4.f, false,
+          [](double x) { return std::log2(x); }, [](float x) { return std::log2(x); },
+          [](float x) { return fast_log2(x); },
+          [](float* o, const float* i, unsigned int n) { fast_map(o, i, n, [](auto v) { return fast_log2(v); }); } },
+        { "sin", -8192.f, 8192.f, false,
+          [](double x) { return std::sin(x); }, [](float x) { return std::sin(x); },
+          [](float x) { return fast_sin(x); }, fast_sin_block },
+        { "cos", -8192.f, 8192.f, false,
+          [](double x) { return std::cos(x); }, [](float x) { return std::cos(x); },
+          [](float x) { return fast_cos(x); },
+          [](float* o, const float* i, unsigned int n) { fast_map(o, i, n, [](auto v) { return fast_cos(v); }); } },
+        { "tanh", -20.f, 20.f, false,
+          [](double x) { return std::tanh(x); }, [](float x) { return std::tanh(x); },
+          [](float x) { return fast_tanh(x); }, fast_tanh_block },
+    };
+
+    const unsigned int n = 1 << 16;
+    std::vector<float> in(n), out(n);
+
+    printf("== math (max ulp over %u points; ns/sample) ==\n", n);
+    printf("%-8s %10s %10s %10s %10s %10s\n", "func", "ulp", "ulp(vec)", "libm", "scalar", "vector");
+    for(const MathCase& c : cases) {
+        for(unsigned int i = 0; i < n; i++) {
+            float t = (i + 0.5f) / n;
+            in[i] = c.logSpaced ? c.lo * std::pow(c.hi / c.lo, t) : c.lo + (c.hi - c.lo) * t;
+        }
+
+        double maxUlp = 0.0, maxUlpVec = 0.0;
+        c.block(out.data(), in.data(), n);
+        for(unsigned int i = 0; i < n; i++) {
+            double ref = c.ref(in[i]);
+            maxUlp = std::fmax(maxUlp, ulpError(c.scalar(in[i]), ref));
+            maxUlpVec = std::fmax(maxUlpVec, ulpError(out[i], ref));
+        }
+
+        double tLibm = timePerElement(n, [&] {
+            for(unsigned int i = 0; i < n; i++) out[i] = c.libm(in[i]);
+            gSink = out[n / 2];
+        });
+        double tScalar = timePerElement(n, [&] {
+            for(unsigned int i = 0; i < n; i++) out[i] = c.scalar(in[i]);
+            gSink = out[n / 2];
+        });
+        double tVec = timePerElement(n, [&] {
+            c.block(out.data(), in.data(), n);
+            gSink = out[n / 2];
+        });
+
+        printf("%-8s %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+               c.name, maxUlp, maxUlpVec, tLibm, tScalar, tVec);
+    }
+}
+
+// ------------------------------------------------------
+// filters: biquad engine and feedback damping
+
+static void runFilters()
+{
+    const unsigned int n = 1 << 16;
+    std::vector<float> buf(n), ch[4];
+    for(unsigned int i = 0; i < n; i++)
+        buf[i] = std::sin(i * 0.01f) + ((i * 2654435761u) >> 28) / 16.f;
+    for(int c = 0; c < 4; c++)
+        ch[c] = buf;
+
+    BiquadCoeffs lp = biquadLowpass(5000.f, 44100.f, 0.7071f);
+    BiquadCoeffs hp = biquadHighpass(60.f, 44100.f, 0.7071f);
+
+    printf("== filters (ns/sample) ==\n");
+
+    // DelayEffect's damping: two scalar sections in series
+    Biquad a, b;
+    a.setTarget(lp);
+    a.snapToTarget();
+    b.setTarget(hp);
+    b.snapToTarget();
+    double tScalar = timePerElement(n, [&] {
+        for(unsigned int i = 0; i < n; i++) buf[i] = b.processSample(a.processSample(buf[i]));
+        gSink = buf[n / 2];
+    });
+    printf("%-28s %8.2f\n", "scalar LP+HP series", tScalar);
+
+    BiquadBank bank;
+    bank.setSection(0, lp);
+    bank.setSection(1, hp);
+    bank.snapToTarget();
+    double tCascade = timePerElement(n, [&] {
+        bank.processCascade(buf.data(), n, 2);
+        gSink = buf[n / 2];
+    });
+    printf("%-28s %8.2f\n", "bank cascade, 2 sections", tCascade);
+
+    for(unsigned int lane = 0; lane < 4; lane++)
+        bank.setSection(lane, lane & 1 ? hp : lp);
+    bank.snapToTarget();
+    double tCascade4 = timePerElement(n, [&] {
+        bank.processCascade(buf.data(), n, 4);
+        gSink = buf[n / 2];
+    });
+    printf("%-28s %8.2f\n", "bank cascade, 4 sections", tCascade4);
+
+    float* chans[4] = { ch[0].data(), ch[1].data(), ch[2].data(), ch[3].data() };
+    double tParallel = timePerElement(n, [&] {
+        bank.processParallel(chans, n);
+        gSink = ch[0][n / 2];
+    });
+    printf("%-28s %8.2f (per channel %.2f)\n", "bank parallel, 4 channels", tParallel, tParallel / 4);
+
+    for(int damped = 0; damped < 2; damped++) {
+        DelayEffect delay(44100, 0.3f, 0.7f, 44100);
+        if(damped)
+            delay.setDamping(5000.f, 60.f);
+        double t = timePerElement(n, [&] {
+            delay.beginBlock();
+            for(unsigned int i = 0; i < n; i++) buf[i] = delay.processSample(buf[i]);
+            gSink = buf[n / 2];
+        });
+        printf("%-28s %8.2f\n", damped ? "DelayEffect, damped" : "DelayEffect, undamped", t);
+    }
+
+    // the buffer size as a constant, as an EngineConfig profile gives it
+    DelayEffect fixed(44100, 0.3f, 0.7f, 44100);
+    double tFixed = timePerElement(n, [&] {
+        fixed.beginBlock();
+        for(unsigned int i = 0; i < n; i++) buf[i] = fixed.processSample<44100>(buf[i]);
+        gSink = buf[n / 2];
+    });
+    printf("%-28s %8.2f\n", "DelayEffect, constant size", tFixed);
+
+    InputStage input(44100.f);
+    double tInput = timePerElement(n, [&] {
+        for(unsigned int i = 0; i + 16 <= n; i += 16) input.processBlock(buf.data() + i, 16);
+        gSink = buf[n / 2];
+    });
+    printf("%-28s %8.2f\n", "InputStage, 16-frame blocks", tInput);
+}
+
+// ------------------------------------------------------
+// lfo: cost per tick of each shape
+
+static void runLfo()
+{
+    const unsigned int n = 1 << 16;
+    std::vector<float> out(n);
+
+    printf("== lfo (ns/tick) ==\n");
+    lfoparams* lfo = init_lfo(nullptr, 3.0f, 44100.0f, 0.0f);
+    for(unsigned int type = 0; type <= MAX_LFOS; type++) {
+        char name[32];
+        get_lfo_name(type, name);
+        set_lfo_type(lfo, type);
+        double t = timePerElement(n, [&] {
+            for(unsigned int i = 0; i < n; i++) out[i] = run_lfo(lfo);
+            gSink = out[n / 2];
+        });
+        printf("%-28s %8.2f\n", name, t);
+    }
+    free(lfo);
+
+    std::vector<float> lanes[4];
+    for(int c = 0; c < 4; c++)
+        lanes[c].resize(n);
+    float* chans[4] = { lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() };
+    RandomLfoBank bank(44100.0f);
+    for(unsigned int lane = 0; lane < 4; lane++)
+        bank.setRate(lane, 1.0f + lane);
+    static const unsigned int shapes[] = { SAMPLE_HOLD, SMOOTH_RANDOM, DRUNK };
+    static const char* names[] = { "bank S&H", "bank smooth random", "bank drunk" };
+    for(int s = 0; s < 3; s++) {
+        bank.setShape(shapes[s]);
+        double t = timePerElement(n, [&] {
+            bank.processBlock(chans, n);
+            gSink = lanes[0][n / 2];
+        });
+        printf("%-28s %8.2f (per lane %.2f)\n", names[s], t, t / 4);
+    }
+}
+
+// ------------------------------------------------------
+// sat: Saturator quality and cost
+
+// Level in dB of frequency `hz` in x (44.1kHz), single-bin DFT
+static double levelDb(const std::vector<float>& x, double hz)
+{
+    double re = 0.0, im = 0.0;
+    for(unsigned int i = 0; i < x.size(); i++) {
+        re += x[i] * std::cos(2.0 * M_PI * hz * i / 44100.0);
+        im += x[i] * std::sin(2.0 * M_PI * hz * i / 44100.0);
+    }
+    return 20.0 * std::log10(2.0 * std::sqrt(re * re + im * im) / x.size() + 1e-12);
+}
+
+// Everything in `x` but a tone at `hz` (least-squares fit), against the
+// tone. With every harmonic above Nyquist, all of it is aliasing.
+static double aliasDb(const std::vector<float>& x, double hz)
+{
+    double ss = 0.0, cc = 0.0, sc = 0.0, xs = 0.0, xc = 0.0, xx = 0.0;
+    for(unsigned int i = 0; i < x.size(); i++) {
+        double s = std::sin(2.0 * M_PI * hz * i / 44100.0), c = std::cos(2.0 * M_PI * hz * i / 44100.0);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        xs += x[i] * s;
+        xc += x[i] * c;
+        xx += (double)x[i] * x[i];
+    }
+    double det = ss * cc - sc * sc;
+    double a = (xs * cc - xc * sc) / det, b = (xc * ss - xs * sc) / det;
+    double tone = a * xs + b * xc;
+    return 10.0 * std::log10((xx - tone) / tone + 1e-30);
+}
+
+static void runSaturation()
+{
+    const unsigned int n = 1 << 16;
+    const double blockNs = 8.0 / 44100.0 * 1e9;   // -p 8
+    std::vector<float> buf(n);
+
+    // Every harmonic is above Nyquist: the 3rd aliases to 900Hz, the 5th to
+    // 13.2kHz, the 7th to 16.8kHz and so on
+    printf("== sat (15kHz at 3x the ceiling: all alias, 900Hz alone) ==\n");
+    printf("%-28s %10s %10s %10s %10s %10s\n", "kernel", "alias dB", "900Hz dB", "ns/sample", "ns/-p 8", "% of -p 8");
+    static const unsigned int factors[] = { 1, 2, 4 };
+    for(unsigned int f : factors) {
+        Saturator sat;
+        sat.setOversampling(f);
+        sat.setCeiling(0.3f);
+        std::vector<float> tone(44100);
+        for(unsigned int i = 0; i < tone.size(); i++)
+            tone[i] = sat.processSample(std::sin(2.0 * M_PI * 15000.0 * i / 44100.0));
+        tone.erase(tone.begin(), tone.begin() + 4410);
+        double alias = aliasDb(tone, 15000.0);
+        double alias900 = levelDb(tone, 900.0) - levelDb(tone, 15000.0);
+
+        for(unsigned int i = 0; i < n; i++)
+            buf[i] = std::sin(i * 0.01f) * 2.0f;
+        double t = timePerElement(n, [&] {
+            sat.processBlock(buf.data(), n);
+            gSink = buf[n / 2];
+        });
+        char name[32];
+        snprintf(name, sizeof(name), "Saturator %ux", f);
+        printf("%-28s %10.1f %10.1f %10.2f %10.1f %10.3f\n", name, alias, alias900, t, t * 8, 100.0 * t * 8 / blockNs);
+    }
+
+    for(unsigned int f : factors) {
+        DelayEffect delay(44100, 0.3f, 0.95f, 44100);
+        delay.setDamping(5000.f, 60.f);
+        delay.setSaturation(1.0f, f);
+        double t = timePerElement(n, [&] {
+            delay.beginBlock();
+            for(unsigned int i = 0; i < n; i++) buf[i] = delay.processSample(buf[i]);
+            gSink = buf[n / 2];
+        });
+        char name[32];
+        snprintf(name, sizeof(name), "DelayEffect, damped, %ux", f);
+        printf("%-28s %10s %10s %10.2f %10.1f %10.3f\n", name, "", "", t, t * 8, 100.0 * t * 8 / blockNs);
+    }
+}
+
+// ------------------------------------------------------
+// loop: LoopBuffer write overhead and reader consistency
+
+static void runLoop()
+{
+    const unsigned int size = 44100 * 20;
+    const unsigned int frames = 8;   // -p 8
+    const unsigned int blocks = size / frames;
+
+    printf("== loop (ns/sample overdubbed, %u-frame blocks) ==\n", frames);
+
+    std::vector<float> plain(size, 0.f);
+    double tPlain = timePerElement(size, [&] {
+        for(unsigned int b = 0; b < blocks; b++)
+            for(unsigned int i = 0; i < frames; i++)
+                plain[b * frames + i] += 0.5f;
+        gSink = plain[size / 2];
+    });
+    printf("%-28s %8.2f\n", "std::vector overdub", tPlain);
+
+    LoopBuffer loop;
+    loop.resize((size + LOOP_CHUNK_SIZE) * 4, size * 2);
+    double tLoop = timePerElement(size, [&] {
+        for(unsigned int b = 0; b < blocks; b++) {
+            for(unsigned int i = 0; i < frames; i++)
+                loop.add(b * frames + i, 0.5f);
+            loop.endBlock();
+        }
+        gSink = loop.read(size / 2);
+    });
+    printf("%-28s %8.2f\n", "LoopBuffer overdub, add()", tLoop);
+
+    // As render() does it: a span resolved per block, written through a
+    // pointer
+    double tSpan = timePerElement(size, [&] {
+        for(unsigned int b = 0; b < blocks; b++) {
+            for(unsigned int i = 0; i < frames; ) {
+                unsigned int n = frames - i;
+                float* span = loop.writeSpan(b * frames + i, n);
+                for(unsigned int k = 0; k < n; k++)
+                    span[k] += 0.5f;
+                i += n;
+            }
+            loop.endBlock();
+        }
+        gSink = loop.read(size / 2);
+    });
+    printf("%-28s %8.2f\n", "LoopBuffer overdub, span", tSpan);
+
+    // Multiplying only adds chunk references; overdubbing one of the
+    // repeats then copies just the chunks it touches
+    unsigned int before = loop.chunksInUse();
+    double t0 = nowNs();
+    bool ok = loop.multiply(size, 4);
+    double tMultiply = nowNs() - t0;
+    unsigned int afterMultiply = loop.chunksInUse();
+    for(unsigned int b = 0; b < blocks / 4; b++) {
+        for(unsigned int i = 0; i < frames; i++)
+            loop.add(2 * size + b * frames + i, 0.5f);
+        loop.endBlock();
+    }
+    printf("%-28s %8.1f us, %s, pool chunks %u -> %u -> %u after overdubbing 5s\n",
+           "multiply x4 (20s loop)", tMultiply * 1e-3, ok ? "ok" : "FAILED",
+           before, afterMultiply, loop.chunksInUse());
+
+    // Every pass adds 1 to the whole loop, a block at a time, so a copy made
+    // at one instant reads pass p up to the write head and p - 1 after it.
+    // Two values inside one block are a torn block; a rise anywhere, or a
+    // spread of more than 1, is chunks copied at different times.
+    loop.clear();
+    std::atomic<bool> done(false);
+    std::thread writer([&] {
+        for(unsigned int pass = 1; pass <= 20; pass++)
+            for(unsigned int b = 0; b < blocks; b++) {
+                for(unsigned int i = 0; i < frames; i++)
+                    loop.add(b * frames + i, 1.f);
+                loop.endBlock();
+            }
+        done = true;
+    });
+
+    std::vector<float> copy(size);
+    unsigned int copies = 0, failed = 0, torn = 0, mixed = 0;
+    long retries = 0;
+    while(!done) {
+        int r = loop.copyOut(copy.data(), 0, size);
+        if(r < 0) {
+            failed++;
+            continue;
+        }
+        retries += r;
+        copies++;
+        for(unsigned int b = 0; b < blocks; b++)
+            for(unsigned int i = 1; i < frames; i++)
+                if(copy[b * frames + i] != copy[b * frames])
+                    torn++;
+        bool consistent = copy[0] - copy[size - 1] <= 1.f;
+        for(unsigned int i = 1; i < size && consistent; i++)
+            consistent = copy[i] <= copy[i - 1];
+        if(!consistent)
+            mixed++;
+    }
+    writer.join();
+    printf("%-28s %u copies (%u gave up), %ld retries, %u torn blocks, %u mixed copies\n", "concurrent reader",
+           copies, failed, retries, torn, mixed);
+
+    // Boot cost of the looper's two 40s pools: zero-filled vectors (as
+    // before), mapped in full, or 4s now and the rest later
+    const unsigned int pool = 44100 * 40;
+    t0 = nowNs();
+    {
+        std::vector<float> a(pool, 0.f), b(pool, 0.f);
+        gSink = a[pool - 1] + b[pool - 1];
+    }
+    double tVector = nowNs() - t0;
+    LoopBuffer eager[2], lazy[2];
+    t0 = nowNs();
+    for(auto& l : eager)
+        l.resize(pool, pool);
+    double tEager = nowNs() - t0;
+    t0 = nowNs();
+    lazy[0].resize(pool, pool, 44100 * 4);
+    lazy[1].resize(pool, pool, 0);
+    double tLazy = nowNs() - t0;
+    t0 = nowNs();
+    for(auto& l : lazy)
+        while(!l.poolReady())
+            l.grow(LOOP_SLAB_CHUNKS);
+    double tGrow = nowNs() - t0;
+    printf("%-28s vectors %.1f ms, mapped %.1f ms, deferred %.2f ms + %.1f ms later\n", "boot, 2 x 40s pools",
+           tVector * 1e-6, tEager * 1e-6, tLazy * 1e-6, tGrow * 1e-6);
+}
+
+// ------------------------------------------------------
+// codec: compressed loop banks
+
+static void runCodec()
+{
+    const unsigned int n = 44100 * 20;
+    std::vector<float> signal(n), decoded(n);
+    std::vector<uint8_t> encoded(loop_codec_bound(n));
+
+    printf("== codec (ratio = encoded / float size, MB/s of float audio) ==\n");
+    printf("%-28s %8s %10s %10s %6s\n", "signal", "ratio", "encode", "decode", "exact");
+    const char* names[] = { "silence", "white noise", "voice-like, -20 dB", "voice-like, gated" };
+    for(int kind = 0; kind < 4; kind++) {
+        uint32_t state = vrandom_seed(1, kind);
+        float lp1 = 0.f, lp2 = 0.f;
+        for(unsigned int i = 0; i < n; i++) {
+            float noise = vrandom(state) - 0.5f;
+            lp1 += 0.05f * (noise - lp1);
+            lp2 += 0.05f * (lp1 - lp2);
+            float x = 0.f;
+            if(kind == 1) x = noise;
+            if(kind == 2) x = 0.75f * lp2;
+            if(kind == 3) x = (i / 22050) % 2 ? 0.75f * lp2 : 0.f;
+            signal[i] = x;
+        }
+        size_t bytes = 0;
+        double tEnc = timePerElement(n, [&] { bytes = loop_encode(signal.data(), n, encoded.data()); }, 3);
+        bool ok = false;
+        double tDec = timePerElement(n, [&] { ok = loop_decode(encoded.data(), bytes, decoded.data(), n); }, 3);
+        ok = ok && memcmp(signal.data(), decoded.data(), n * sizeof(float)) == 0;
+        printf("%-28s %8.3f %10.1f %10.1f %6s\n", names[kind], (double)bytes / (n * sizeof(float)),
+               4e3 / tEnc, 4e3 / tDec, ok ? "yes" : "NO");
+    }
+
+    // The gated take, stored into a bank and restored into a fresh buffer
+    LoopBuffer live, spare;
+    live.resize(n + LOOP_CHUNK_SIZE, n + LOOP_CHUNK_SIZE);
+    spare.resize(n + LOOP_CHUNK_SIZE, n + LOOP_CHUNK_SIZE);
+    for(unsigned int i = 0; i < n; i++) {
+        if(signal[i] != 0.f)
+            live.add(i, signal[i]);
+        if(i % 8 == 7)
+            live.endBlock();
+    }
+    live.endBlock();
+    LoopBank bank;
+    bank.resize(1);
+    double t0 = nowNs();
+    bool stored = bank.store(0, live, n);
+    double tStore = nowNs() - t0;
+    size_t bytes = bank.compressedBytes(0);
+    t0 = nowNs();
+    unsigned int length = bank.restore(0, spare);
+    double tRestore = nowNs() - t0;
+    std::vector<float> a(n), b(n);
+    live.copyOut(a.data(), 0, n);
+    spare.copyOut(b.data(), 0, n);
+    bool same = stored && length == n && memcmp(a.data(), b.data(), n * sizeof(float)) == 0;
+    printf("%-28s %.1f MB -> %.1f MB, store %.1f ms, restore %.1f ms, %s\n", "20s gated take, banked",
+           n * 4e-6, bytes * 1e-6, tStore * 1e-6, tRestore * 1e-6, same ? "identical" : "MISMATCH");
+}
+
+// ------------------------------------------------------
+// pipeline: multi-core effect chain
+
+// A heavy stage: delay with damping, optionally with 4x oversampled
+// saturation, so the stages are deliberately uneven
+class DelayStage : public EffectStage {
+public:
+    DelayStage(unsigned int index, bool saturate)
+        : delay(44100, 0.05f + 0.01f * index, 0.6f, 44100)
+    {
+        delay.setDamping(5000.f, 60.f);
+        if(saturate)
+            delay.setSaturation(1.f, 4);
+        snprintf(label, sizeof(label), "delay%u%s", index, saturate ? "+sat" : "");
+    }
+    void process(float* block, unsigned int n) override
+    {
+        delay.beginBlock();
+        for(unsigned int i = 0; i < n; i++)
+            block[i] = delay.processSample(block[i]);
+    }
+    const char* name() const override { return label; }
+
+private:
+    DelayEffect delay;
+    char label[16];
+};
+
+static void runPipeline()
+{
+    const unsigned int stagesCount = 8;
+    const unsigned int blocks = 20000;
+    printf("== pipeline (%u stages, %u hardware threads) ==\n", stagesCount, std::thread::hardware_concurrency());
+    printf("%-28s %10s %10s %10s %10s %8s\n", "mode", "block", "ns/block", "speedup", "missed", "output");
+
+    for(unsigned int blockSize : { 8u, 64u }) {
+        std::vector<DelayStage*> owned;
+        double inlineNs = 0.0;
+        std::vector<float> reference;   // inline output
+        for(unsigned int workers : { 0u, 1u, 2u, 4u }) {
+            Pipeline chain;
+            for(unsigned int i = 0; i < stagesCount; i++) {
+                owned.push_back(new DelayStage(i, i % 3 == 0));
+                chain.addStage(owned.back());
+            }
+            // inline first, so the split is made from measured costs
+            std::vector<float> block(blockSize), output;
+            output.reserve((size_t)blocks * blockSize);
+            uint32_t state = vrandom_seed(3, 0);
+            chain.start(blockSize, 44100.f, 0);
+            for(unsigned int b = 0; b < 4096; b++) {
+                for(unsigned int i = 0; i < blockSize; i++)
+                    block[i] = 0.1f * (vrandom(state) - 0.5f);
+                chain.process(block.data(), blockSize);
+            }
+            chain.start(blockSize, 44100.f, workers);
+
+            double t0 = nowNs();
+            for(unsigned int b = 0; b < blocks; b++) {
+                for(unsigned int i = 0; i < blockSize; i++)
+                    block[i] = 0.1f * (vrandom(state) - 0.5f);
+                while(!chain.ready())
+                    std::this_thread::yield();
+                chain.process(block.data(), blockSize);
+                output.insert(output.end(), block.begin(), block.end());
+            }
+            double ns = (nowNs() - t0) / blocks;
+            unsigned int late = chain.latencyBlocks();
+            if(workers == 2 && blockSize == 64) {
+                for(unsigned int i = 0; i < chain.numStages(); i++)
+                    printf("    %-12s worker %u %8.0f ns/block\n", chain.stageName(i), chain.stageWorker(i), chain.stageCost(i));
+                for(unsigned int w = 0; w < chain.numWorkers(); w++)
+                    printf("    worker %u load %.0f%% of a %u-frame block\n", w, 100.f * chain.workerLoad(w), blockSize);
+            }
+
+            // a block longer than the queues' is refused, not overrun
+            unsigned int overruns = chain.overruns();
+            std::vector<float> longBlock(2 * blockSize, 0.1f);
+            chain.process(longBlock.data(), 2 * blockSize);
+            bool refused = !workers || (chain.overruns() == overruns + 1 && longBlock[0] == 0.f);
+
+            // stopped, it runs inline again: output straight away
+            chain.stop();
+            unsigned int underruns = chain.underruns();
+            bool live = false;
+            for(unsigned int b = 0; b < 4; b++) {
+                for(unsigned int i = 0; i < blockSize; i++)
+                    block[i] = 0.1f * (vrandom(state) - 0.5f);
+                chain.process(block.data(), blockSize);
+                for(unsigned int i = 0; i < blockSize; i++)
+                    live = live || block[i] != 0.f;
+            }
+            bool stopped = live && chain.underruns() == underruns && chain.latencyBlocks() == 0;
+
+            if(workers == 0) {
+                inlineNs = ns;
+                reference = output;
+            }
+            // pipelined output must be the inline output, latencyBlocks() later
+            size_t shift = (size_t)late * blockSize;
+            bool same = memcmp(output.data() + shift, reference.data(), (output.size() - shift) * sizeof(float)) == 0;
+
+            char mode[32];
+            snprintf(mode, sizeof(mode), workers ? "%u workers, %u blocks late" : "inline", workers, late);
+            printf("%-28s %10u %10.0f %10.2f %10u %8s\n", mode, blockSize, ns, inlineNs / ns, chain.underruns(),
+                   !same ? "DIFFERS" : !refused ? "OVERRUN" : !stopped ? "STUCK" : "same");
+        }
+        for(DelayStage* stage : owned)
+            delete stage;
+    }
+}
+
+// ------------------------------------------------------
+static void spin(double ns)
+{
+    double t0 = nowNs();
+    while(nowNs() - t0 < ns)
+        ;
+}
+
+// `steps` steps of `stepNs` busy work each
+class SpinJob : public Job {
+public:
+    unsigned int steps;
+    double stepNs;
+    double finished;
+
+    bool step() override
+    {
+        spin(stepNs);
+        if(--steps)
+            return false;
+        finished = nowNs();
+        return true;
+    }
+};
+
+class StoreJob : public Job {
+public:
+    LoopBank* bank;
+    const LoopBuffer* loop;
+    unsigned int length;
+    unsigned int pos;
+    unsigned int chunks;
+
+    bool step() override
+    {
+        bank->storeSome(0, *loop, length, pos, chunks);
+        return pos >= length;
+    }
+};
+
+static std::atomic<bool> gJobWake(false);
+static void wakeRunner(void*)
+{
+    gJobWake.store(true);
+}
+
+static void runJobs()
+{
+    printf("== jobs ==\n");
+    {
+        // overhead: trivial one-step jobs through enqueue and the runner
+        const unsigned int n = 1000;
+        std::vector<SpinJob> jobs(n);
+        JobScheduler sched;
+        double tEnqueue = 0.0, tRun = 0.0;
+        for(int r = 0; r < 5; r++) {
+            for(auto& job : jobs) {
+                job.steps = 1;
+                job.stepNs = 0.0;
+            }
+            double t0 = nowNs();
+            for(unsigned int i = 0; i < n; i++)
+                sched.enqueue(jobs[i], (JobPriority)(i % JOB_PRIORITIES));
+            double t1 = nowNs();
+            sched.runUntilIdle(1000000, 0);
+            double t2 = nowNs();
+            tEnqueue = r ? std::min(tEnqueue, (t1 - t0) / n) : (t1 - t0) / n;
+            tRun = r ? std::min(tRun, (t2 - t1) / n) : (t2 - t1) / n;
+        }
+        printf("%-36s %8.0f ns\n", "enqueue (lock-free)", tEnqueue);
+        printf("%-36s %8.0f ns\n", "pick + step + retire, empty step", tRun);
+    }
+
+    // A 20s voice-like take stored into a bank: one call, or steps
+    const unsigned int n = 44100 * 20;
+    LoopBuffer loop;
+    loop.resize(n + LOOP_CHUNK_SIZE, n + LOOP_CHUNK_SIZE);
+    uint32_t state = vrandom_seed(5, 0);
+    float lp1 = 0.f, lp2 = 0.f;
+    for(unsigned int i = 0; i < n; i++) {
+        lp1 += 0.05f * (vrandom(state) - 0.5f - lp1);
+        lp2 += 0.05f * (lp1 - lp2);
+        loop.add(i, 0.75f * lp2);
+        if(i % 8 == 7)
+            loop.endBlock();
+    }
+    loop.endBlock();
+    LoopBank bank;
+    bank.resize(1);
+    double t0 = nowNs();
+    bank.store(0, loop, n);
+    printf("%-36s %8.2f ms\n", "20s bank store, one call", (nowNs() - t0) * 1e-6);
+    for(unsigned int chunks : { 1u, 8u, 32u }) {
+        JobScheduler sched;
+        StoreJob job;
+        job.bank = &bank;
+        job.loop = &loop;
+        job.length = n;
+        job.pos = 0;
+        job.chunks = chunks;
+        sched.enqueue(job, JOB_NORMAL);
+        t0 = nowNs();
+        sched.runUntilIdle(1000000, 0);
+        char label[64];
+        snprintf(label, sizeof(label), "  in steps of %u chunks", chunks);
+        printf("%-36s %8.2f ms, longest step %.2f ms\n", label, (nowNs() - t0) * 1e-6, sched.longestStep() * 1e-3);
+    }
+
+    // Responsiveness: a backlog of 200ms of normal and low priority work
+    // on a runner thread, then a short high-priority job from this one
+    JobScheduler sched;
+    sched.setWakeup(wakeRunner, nullptr);
+    std::atomic<bool> stop(false);
+    std::thread runner([&] {
+        while(!stop.load()) {
+            if(gJobWake.exchange(false))
+                sched.runUntilIdle(2000, 500);
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    SpinJob normal, low, urgent;
+    normal.steps = 400;
+    normal.stepNs = 250e3;
+    low.steps = 400;
+    low.stepNs = 250e3;
+    urgent.steps = 4;
+    urgent.stepNs = 250e3;
+    double start = nowNs();
+    sched.enqueue(low, JOB_LOW);
+    sched.enqueue(normal, JOB_NORMAL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    double urgentStart = nowNs();
+    sched.enqueue(urgent, JOB_HIGH);
+    while(low.busy() || normal.busy() || urgent.busy())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    stop.store(true);
+    runner.join();
+    printf("%-36s %8.1f ms after enqueue (1 ms of work)\n", "high priority job done", (urgent.finished - urgentStart) * 1e-6);
+    printf("%-36s %8.1f ms, then low %.1f ms (100 ms of work each)\n", "normal priority job done",
+           (normal.finished - start) * 1e-6, (low.finished - start) * 1e-6);
+}
+
+// ------------------------------------------------------
+static void runSpectrum()
+{
+    printf("== spectrum ==\n");
+    for(unsigned int n : { 1024u, 65536u }) {
+        Fft fft;
+        fft.resize(n);
+        std::vector<float> x(n), y(n);
+        std::vector<Complex> X(n / 2 + 1);
+        uint32_t state = vrandom_seed(7, n);
+        for(auto& v : x)
+            v = vrandom(state) - 0.5f;
+        double t = timePerElement(1, [&] { fft.forward(x.data(), X.data()); gSink = X[1].re; });
+        fft.inverse(X.data(), y.data());
+        double roundTrip = 0.0, peak = 0.0;
+        for(unsigned int i = 0; i < n; i++) {
+            roundTrip = std::max(roundTrip, (double)std::fabs(y[i] / n - x[i]));
+            peak = std::max(peak, (double)std::fabs(x[i]));
+        }
+        // every bin of the small one against a direct DFT
+        double dftError = 0.0;
+        if(n <= 1024) {
+            double scale = 0.0;
+            for(unsigned int k = 0; k <= n / 2; k++) {
+                double re = 0.0, im = 0.0;
+                for(unsigned int i = 0; i < n; i++) {
+                    re += x[i] * std::cos(2.0 * M_PI * k * i / n);
+                    im -= x[i] * std::sin(2.0 * M_PI * k * i / n);
+                }
+                dftError = std::max(dftError, std::hypot(X[k].re - re, X[k].im - im));
+                scale = std::max(scale, std::hypot(re, im));
+            }
+            dftError /= scale;
+        }
+        char label[64], vsDft[32] = "";
+        snprintf(label, sizeof(label), "real FFT, %u points", n);
+        if(n <= 1024)
+            snprintf(vsDft, sizeof(vsDft), ", vs DFT %.1e", dftError);
+        printf("%-28s %9.1f us, round trip error %.1e%s\n", label, t * 1e-3, roundTrip / peak, vsDft);
+    }
+
+    // What render() pays: one push per 8-frame block
+    AudioTap tap;
+    tap.resize(8192);
+    std::vector<float> block(8, 0.25f);
+    double tPush = timePerElement(100000, [&] {
+        for(int i = 0; i < 100000; i++)
+            tap.push(block.data(), 8);
+    });
+    printf("%-28s %9.1f ns per 8-frame block\n", "AudioTap push", tPush);
+
+    // A writer pushing a ramp against a reader taking frames: every frame
+    // read successfully must be a run of consecutive values
+    {
+        AudioTap ramp;
+        ramp.resize(2048);
+        std::atomic<bool> done(false);
+        std::thread writer([&] {
+            float v[8];
+            for(uint32_t c = 0; c < 4000000; c += 8) {
+                for(int i = 0; i < 8; i++)
+                    v[i] = (float)((c + i) & 0xffff);
+                ramp.push(v, 8);
+            }
+            done.store(true);
+        });
+        std::vector<float> frame(SPECTRUM_SIZE);
+        unsigned int good = 0, lapped = 0, torn = 0;
+        while(!done.load()) {
+            uint32_t w = ramp.written();
+            if(w < SPECTRUM_SIZE)
+                continue;
+            uint32_t from = w - SPECTRUM_SIZE;
+            if(!ramp.read(from, frame.data(), SPECTRUM_SIZE)) {
+                lapped++;
+                continue;
+            }
+            good++;
+            for(unsigned int i = 0; i < SPECTRUM_SIZE; i++)
+                if(frame[i] != (float)((from + i) & 0xffff))
+                    torn++;
+        }
+        writer.join();
+        printf("%-28s %u frames, %u lapped and retried, %u torn samples\n", "concurrent tap reader", good, lapped, torn);
+    }
+
+    // A -6 dBFS 1 kHz sine with -60 dB of noise, as the analysis job sees it
+    {
+        AudioTap input;
+        input.resize(8192);
+        SpectrumAnalyser analyser;
+        analyser.setup(&input, SPECTRUM_SIZE / 2, 44100.f);
+        uint32_t state = vrandom_seed(8, 0);
+        unsigned int frames = 0;
+        double tAnalyse = 0.0;
+        for(unsigned int b = 0; b < 44100 / 8; b++) {
+            float v[8];
+            for(int i = 0; i < 8; i++) {
+                unsigned int t = b * 8 + i;
+                v[i] = 0.5f * std::sin(2.f * (float)M_PI * 1000.f * t / 44100.f) + 0.002f * (vrandom(state) - 0.5f);
+            }
+            input.push(v, 8);
+            double t0 = nowNs();
+            while(analyser.analyseNext())
+                frames++;
+            tAnalyse += nowNs() - t0;
+        }
+        const float* spectrum = analyser.latest();
+        unsigned int peak = 0;
+        for(unsigned int k = 1; k < SPECTRUM_BINS; k++)
+            if(spectrum[k] > spectrum[peak])
+                peak = k;
+        float floor = 0.f;
+        for(unsigned int k = SPECTRUM_BINS / 2; k < SPECTRUM_BINS; k++)
+            floor += spectrum[k] / (SPECTRUM_BINS - SPECTRUM_BINS / 2);
+        printf("%-28s peak %.0f Hz at %.2f dB (-6.02 expected), floor %.0f dB, %.1f us/frame, %u skipped\n",
+               "analyser, 1 kHz sine", analyser.binFrequency(peak), spectrum[peak], floor,
+               tAnalyse * 1e-3 / frames, analyser.framesSkipped());
+    }
+}
+
+// ------------------------------------------------------
+// interp: quality against cost of the fractional readers
+
+typedef float (*InterpKernel)(const float*, float);
+
+// A sine of `hz` (44.1kHz) read at `speed` from a fractional start, its
+// read position also swept by `depth` samples at 3 Hz, as a modulated
+// delay sweeps it. The output is fitted to the ideal (the sine at the
+// exact positions) in gain and phase, and what the fit leaves is the
+// distortion, aliasing and sideband energy: returns it in dB against the
+// fitted signal.
+static double spuriousDb(InterpKernel kernel, double hz, double speed, double depth)
+{
+    const unsigned int n = 1 << 14;
+    const double w = 2.0 * M_PI * hz / 44100.0;
+    double start = INTERP_BEFORE + depth + 0.37;
+    unsigned int length = (unsigned int)(start + n * speed + depth) + INTERP_AFTER + 2;
+    std::vector<float> x(length);
+    for(unsigned int k = 0; k < length; k++)
+        x[k] = (float)std::sin(w * k);
+
+    std::vector<double> y(n), s(n), c(n);
+    double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+    for(unsigned int i = 0; i < n; i++) {
+        double pos = start + i * speed + depth * std::sin(2.0 * M_PI * 3.0 * i / 44100.0);
+        unsigned int k = (unsigned int)pos;
+        y[i] = kernel(&x[k], (float)(pos - k));
+        s[i] = std::sin(w * pos);
+        c[i] = std::cos(w * pos);
+        ss += s[i] * s[i];
+        cc += c[i] * c[i];
+        sc += s[i] * c[i];
+        ys += y[i] * s[i];
+        yc += y[i] * c[i];
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+    double fit = 0.0, residual = 0.0;
+    for(unsigned int i = 0; i < n; i++) {
+        double f = a * s[i] + b * c[i];
+        fit += f * f;
+        residual += (y[i] - f) * (y[i] - f);
+    }
+    return 10.0 * std::log10(residual / fit + 1e-30);
+}
+
+// A sine of `hz` (44.1kHz) read at `speed` from a fractional start, where
+// hz * speed is past the output's Nyquist: the band-limited ideal is
+// silence, so everything read is aliasing. Returns it in dB against the
+// sine.
+static double aliasDb(InterpKernel kernel, double hz, double speed)
+{
+    const unsigned int n = 1 << 14;
+    const double w = 2.0 * M_PI * hz / 44100.0;
+    double start = INTERP_BEFORE + 0.37;
+    unsigned int length = (unsigned int)(start + n * speed) + INTERP_AFTER + 2;
+    std::vector<float> x(length);
+    for(unsigned int k = 0; k < length; k++)
+        x[k] = (float)std::sin(w * k);
+
+    double energy = 0.0;
+    for(unsigned int i = 0; i < n; i++) {
+        double pos = start + i * speed;
+        unsigned int k = (unsigned int)pos;
+        double y = kernel(&x[k], (float)(pos - k));
+        energy += y * y;
+    }
+    return 10.0 * std::log10(energy / (0.5 * n) + 1e-30);
+}
+
+// Worst error, in dB against the signal, of a reader standing still
+// between two samples, from DC to `hz` and over every read position: its
+// response against an ideal fractional delay to that position, so both
+// the gain and the phase (where it actually reads from) count
+static double delayErrorDb(InterpKernel kernel, double hz)
+{
+    const int taps = INTERP_BEFORE + INTERP_AFTER + 1;
+    float impulse[2 * taps + 1];
+    double worst = 0.0;
+    for(unsigned int p = 0; p < 64; p++) {
+        float frac = p / 64.f;
+        double h[taps];
+        for(int d = 0; d < taps; d++) {
+            std::fill(impulse, impulse + 2 * taps + 1, 0.f);
+            impulse[taps + d - INTERP_BEFORE] = 1.f;
+            h[d] = kernel(&impulse[taps], frac);
+        }
+        for(double f = 0.0; f <= hz; f += hz / 64) {
+            // the ideal reader reads at +frac: e^(jw frac)
+            double w = 2.0 * M_PI * f / 44100.0;
+            double re = -std::cos(w * frac), im = -std::sin(w * frac);
+            for(int d = 0; d < taps; d++) {
+                re += h[d] * std::cos(w * (d - INTERP_BEFORE));
+                im += h[d] * std::sin(w * (d - INTERP_BEFORE));
+            }
+            worst = std::fmax(worst, re * re + im * im);
+        }
+    }
+    return 10.0 * std::log10(worst + 1e-30);
+}
+
+// ns per output sample of a reader running through `in` at `speed`
+template <InterpKernel Kernel>
+static double interpCost(const std::vector<float>& in, float speed)
+{
+    const unsigned int n = 1 << 16;
+    std::vector<float> out(n);
+    const float end = (float)(in.size() - INTERP_AFTER - 2);
+    return timePerElement(n, [&] {
+        float pos = INTERP_BEFORE;
+        for(unsigned int i = 0; i < n; i++) {
+            unsigned int k = (unsigned int)pos;
+            out[i] = Kernel(&in[k], pos - (float)k);
+            pos += speed;
+            if(pos >= end)
+                pos -= end - INTERP_BEFORE;
+        }
+        gSink = out[n / 2];
+    });
+}
+
+struct InterpCase {
+    const char* name;
+    InterpKernel kernel;
+    double (*cost)(const std::vector<float>&, float);
+};
+
+static void runInterp()
+{
+    static const InterpCase kernels[] = {
+        { "truncate", interp_truncate, interpCost<interp_truncate> },
+        { "linear",   interp_linear,   interpCost<interp_linear> },
+        { "hermite",  interp_hermite,  interpCost<interp_hermite> },
+        { "lagrange", interp_lagrange, interpCost<interp_lagrange> },
+        { "sinc",     interp_sinc,     interpCost<interp_sinc> },
+    };
+    const unsigned int numKernels = sizeof(kernels) / sizeof(kernels[0]);
+    // varispeed down an octave, a fifth, up a semitone, a fifth, not quite
+    // an octave (at 2.0 every read lands 0.37 past a sample: a fixed
+    // fractional delay, which only filters)
+    static const double speeds[] = { 0.5, 0.75, 1.0595, 1.5, 1.99 };
+    static const double depths[] = { 1.0, 10.0, 100.0 };
+    const unsigned int numSpeeds = sizeof(speeds) / sizeof(speeds[0]);
+    const unsigned int numDepths = sizeof(depths) / sizeof(depths[0]);
+
+    std::vector<float> in(1 << 16);
+    for(unsigned int i = 0; i < in.size(); i++)
+        in[i] = std::sin(i * 0.01f) + ((i * 2654435761u) >> 28) / 16.f;
+
+    // worst case of each quality measure, and the cost, per kernel
+    double cost[numKernels], thdn[numKernels], images[numKernels], alias[numKernels], delayError[numKernels],
+        sidebands[numKernels];
+
+    printf("== interp (dB against the signal; ns/sample) ==\n");
+    printf("%-10s %6s %10s %10s %10s %10s\n", "kernel", "speed", "THD+N 1k", "spur 10k", "alias", "ns/sample");
+    for(unsigned int k = 0; k < numKernels; k++) {
+        const InterpCase& c = kernels[k];
+        thdn[k] = images[k] = alias[k] = -1e30;
+        cost[k] = 0.0;
+        for(unsigned int s = 0; s < numSpeeds; s++) {
+            // 10 kHz stays in band up to 2.2x: what the fit leaves is
+            // images and distortion. Sped up, a tone halfway between the
+            // output's Nyquist (22050 / speed) and the input's folds back.
+            double t = spuriousDb(c.kernel, 1000.0, speeds[s], 0.0);
+            double i = spuriousDb(c.kernel, 10000.0, speeds[s], 0.0);
+            double a = speeds[s] > 1.0 ? aliasDb(c.kernel, 0.5 * (22050.0 / speeds[s] + 22050.0), speeds[s]) : -1e30;
+            double ns = c.cost(in, (float)speeds[s]);
+            thdn[k] = std::fmax(thdn[k], t);
+            images[k] = std::fmax(images[k], i);
+            alias[k] = std::fmax(alias[k], a);
+            cost[k] = std::fmax(cost[k], ns);
+            char aliasText[16] = "-";
+            if(speeds[s] > 1.0)
+                snprintf(aliasText, sizeof(aliasText), "%.1f", a);
+            printf("%-10s %5.2fx %10.1f %10.1f %10s %10.2f\n", c.name, speeds[s], t, i, aliasText, ns);
+        }
+    }
+
+    printf("%-10s %6s %10s\n", "kernel", "depth", "sidebands");
+    for(unsigned int k = 0; k < numKernels; k++) {
+        const InterpCase& c = kernels[k];
+        sidebands[k] = -1e30;
+        for(unsigned int d = 0; d < numDepths; d++) {
+            // a 5 kHz tone through a delay swept by `depth` samples at 3 Hz
+            double sb = spuriousDb(c.kernel, 5000.0, 1.0, depths[d]);
+            sidebands[k] = std::fmax(sidebands[k], sb);
+            printf("%-10s %6.0f %10.1f\n", c.name, depths[d], sb);
+        }
+        delayError[k] = delayErrorDb(c.kernel, 10000.0);
+    }
+
+    // A kernel is on the Pareto front unless another is no dearer and no
+    // worse on any measure, and better on one
+    printf("%-10s %10s %10s %10s %10s %10s %10s %8s\n", "Pareto", "ns/sample", "THD+N", "spur", "alias", "delay err",
+           "sidebands", "front");
+    for(unsigned int k = 0; k < numKernels; k++) {
+        bool dominated = false;
+        for(unsigned int j = 0; j < numKernels && !dominated; j++) {
+            if(j == k)
+                continue;
+            bool noWorse = cost[j] <= cost[k] && thdn[j] <= thdn[k] && images[j] <= images[k] && alias[j] <= alias[k]
+                           && delayError[j] <= delayError[k] && sidebands[j] <= sidebands[k];
+            bool better = cost[j] < cost[k] || thdn[j] < thdn[k] || images[j] < images[k] || alias[j] < alias[k]
+                          || delayError[j] < delayError[k] || sidebands[j] < sidebands[k];
+            dominated = noWorse && better;
+        }
+        printf("%-10s %10.2f %10.1f %10.1f %10.1f %10.1f %10.1f %8s\n", kernels[k].name, cost[k], thdn[k], images[k],
+               alias[k], delayError[k], sidebands[k], dominated ? "" : "yes");
+    }
+
+    // The cheapest kernel whose worst THD+N, spurious, delay error and
+    // sidebands all meet a bar, for deployment profiles from lo-fi to
+    // clean; and sped up, whose aliasing does too. None of these readers
+    // band-limits: that takes a cutoff that follows 22050 / speed.
+    static const double bars[] = { -20.0, -30.0, -40.0, -50.0 };
+    for(double bar : bars) {
+        int best = -1, bestSpedUp = -1;
+        for(unsigned int k = 0; k < numKernels; k++) {
+            if(thdn[k] > bar || images[k] > bar || delayError[k] > bar || sidebands[k] > bar)
+                continue;
+            if(best < 0 || cost[k] < cost[best])
+                best = (int)k;
+            if(alias[k] <= bar && (bestSpedUp < 0 || cost[k] < cost[bestSpedUp]))
+                bestSpedUp = (int)k;
+        }
+        printf("cheapest at %4.0f dB: %-10s sped up: %s\n", bar, best < 0 ? "none" : kernels[best].name,
+               bestSpedUp < 0 ? "none" : kernels[bestSpedUp].name);
+    }
+}
+
+// ------------------------------------------------------
+// counters: where the time goes, per kernel
+
+static PerfCounters gCounters;
+
+struct KernelProfile {
+    double ns;
+    double counts[PERF_NUM_EVENTS];
+};
+
+// Best-of-`runs` time per element of fn(), which processes `n` elements,
+// and the counters of that run per element
+template <typename F>
+static KernelProfile profileKernel(unsigned int n, F fn, int runs = 7)
+{
+    KernelProfile best;
+    best.ns = 1e30;
+    for(int r = 0; r < runs; r++) {
+        gCounters.reset();
+        gCounters.start();
+        fn();
+        gCounters.stop();
+        double t = gCounters.elapsedNs() / n;
+        if(t >= best.ns)
+            continue;
+        best.ns = t;
+        for(int e = 0; e < PERF_NUM_EVENTS; e++) {
+            double v = gCounters.value((PerfEvent)e);
+            best.counts[e] = v < 0.0 ? -1.0 : v / n;
+        }
+    }
+    return best;
+}
+
+static void printProfileHeader(const char* unit)
+{
+    printf("%-28s %9s", unit, "ns");
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        printf(" %9s", PerfCounters::name((PerfEvent)e));
+    printf(" %6s\n", "IPC");
+}
+
+static void printProfile(const char* name, const KernelProfile& p)
+{
+    printf("%-28s %9.2f", name, p.ns);
+    for(int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if(p.counts[e] < 0.0)
+            printf(" %9s", "-");
+        else
+            printf(" %9.3f", p.counts[e]);
+    }
+    if(p.counts[PERF_CYCLES] > 0.0 && p.counts[PERF_INSTRUCTIONS] >= 0.0)
+        printf(" %6.2f\n", p.counts[PERF_INSTRUCTIONS] / p.counts[PERF_CYCLES]);
+    else
+        printf(" %6s\n", "-");
+}
+
+static void runCounters()
+{
+    const unsigned int n = 1 << 16;
+    std::vector<float> buf(n);
+    for(unsigned int i = 0; i < n; i++)
+        buf[i] = std::sin(i * 0.01f) + ((i * 2654435761u) >> 28) / 16.f;
+
+    printf("== counters (per sample) ==\n");
+    if(!gCounters.open())
+        printf("hardware counters unavailable: %s; timing only\n", gCounters.error());
+    printProfileHeader("kernel");
+
+    for(int damped = 0; damped < 2; damped++) {
+        DelayEffect delay(44100, 0.3f, 0.7f, 44100);
+        if(damped)
+            delay.setDamping(5000.f, 60.f);
+        printProfile(damped ? "DelayEffect, damped" : "DelayEffect, undamped", profileKernel(n, [&] {
+            delay.beginBlock();
+            for(unsigned int i = 0; i < n; i++) buf[i] = delay.processSample(buf[i]);
+            gSink = buf[n / 2];
+        }));
+    }
+
+    lfoparams* lfo = init_lfo(nullptr, 3.0f, 44100.0f, 0.0f);
+    for(unsigned int type = 0; type <= MAX_LFOS; type++) {
+        char lfoName[32], name[40];
+        get_lfo_name(type, lfoName);   // always writes 30 bytes
+        snprintf(name, sizeof(name), "lfo %s", lfoName);
+        set_lfo_type(lfo, type);
+        printProfile(name, profileKernel(n, [&] {
+            for(unsigned int i = 0; i < n; i++) buf[i] = run_lfo(lfo);
+            gSink = buf[n / 2];
+        }));
+    }
+    free(lfo);
+
+    std::vector<float> lanes[4];
+    for(int c = 0; c < 4; c++)
+        lanes[c].resize(n);
+    float* chans[4] = { lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() };
+    RandomLfoBank bank(44100.0f);
+    bank.setShape(SMOOTH_RANDOM);
+    printProfile("lfo bank, 4 lanes", profileKernel(n, [&] {
+        bank.processBlock(chans, n);
+        gSink = lanes[0][n / 2];
+    }));
+
+    // Playback as render() reads the loop. The play head carries on from
+    // run to run, so faster speeds stream through more of the 20s loop
+    // and reverse walks the chunks backwards.
+    const unsigned int loopLength = 44100 * 20;
+    LoopBuffer loop;
+    loop.resize((loopLength + LOOP_CHUNK_SIZE) * 4, loopLength * 2);
+    for(unsigned int i = 0; i < loopLength; i++) {
+        loop.add(i, buf[i % n]);
+        if(i % 8 == 7)
+            loop.endBlock();
+    }
+    loop.endBlock();
+    static const float speeds[] = { 0.5f, 1.f, 2.f, -1.f, -2.f };
+    for(float speed : speeds) {
+        float readIndex = 0.f;
+        char name[32];
+        snprintf(name, sizeof(name), "playback %+.1fx", speed);
+        printProfile(name, profileKernel(n, [&] {
+            for(unsigned int i = 0; i < n; i++) {
+                buf[i] = loop.read((int)readIndex % loopLength);
+                readIndex += speed;
+                if(readIndex < 0)
+                    readIndex += loopLength;
+                else if(readIndex >= loopLength)
+                    readIndex -= loopLength;
+            }
+            gSink = buf[n / 2];
+        }));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* only = argc > 1 ? argv[1] : nullptr;
+    if(!only || !strcmp(only, "math"))
+        runMath();
+    if(!only || !strcmp(only, "filters"))
+        runFilters();
+    if(!only || !strcmp(only, "lfo"))
+        runLfo();
+    if(!only || !strcmp(only, "sat"))
+        runSaturation();
+    if(!only || !strcmp(only, "loop"))
+        runLoop();
+    if(!only || !strcmp(only, "codec"))
+        runCodec();
+    if(!only || !strcmp(only, "pipeline"))
+        runPipeline();
+    if(!only || !strcmp(only, "jobs"))
+        runJobs();
+    if(!only || !strcmp(only, "spectrum"))
+        runSpectrum();
+    if(!only || !strcmp(only, "interp"))
+        runInterp();
+    if(!only || !strcmp(only, "counters"))
+        runCounters();
+    return 0;
+}
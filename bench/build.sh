@@ -0,0 +1,28 @@
+#!/bin/sh
+# Builds the host benchmark harness and the Bela simulator. Extra compiler flags can be passed
+# through CXXFLAGS, e.g. CXXFLAGS="-march=native" ./build.sh, and the binaries put elsewhere
+# with OUT=dir
+set -e
+cd "$(dirname "$0")"
+SRC=../LOOPY_MicLooper
+OUT=${OUT:-.}
+mkdir -p "$OUT"
+ENGINE="$SRC/lfo.cpp $SRC/DelayEffect.cpp $SRC/ModCurve.cpp $SRC/Tables.cpp $SRC/Biquad.cpp $SRC/InputStage.cpp $SRC/EnvelopeFollower.cpp \
+    $SRC/ModMatrix.cpp $SRC/RandomLfoBank.cpp \
+    $SRC/Saturator.cpp $SRC/LoopBuffer.cpp $SRC/LoopCodec.cpp $SRC/LoopBank.cpp $SRC/LatencyCalibrator.cpp $SRC/Pipeline.cpp $SRC/JobScheduler.cpp \
+    $SRC/Fft.cpp $SRC/SpectrumAnalyser.cpp $SRC/LoopPointFinder.cpp"
+
+${CXX:-g++} -std=c++14 -O2 ${CXXFLAGS} -I"$SRC" \
+    bench.cpp PerfCounters.cpp $ENGINE \
+    -o "$OUT/bench" -lm -lpthread
+
+# The whole Bela project, render.cpp included, against the host simulator
+${CXX:-g++} -std=c++14 -O2 ${CXXFLAGS} -Isim -I. -I"$SRC" \
+    loopy_sim.cpp sim/Sim.cpp PerfCounters.cpp "$SRC/render.cpp" $ENGINE \
+    -o "$OUT/loopy_sim" -lm -lpthread
+
+# The simulator again with -ffast-math, as the Bela build compiles the project: the NaN/Inf
+# guards must still fire (loopy_sim_fastmath nonfinite)
+${CXX:-g++} -std=c++14 -O3 -ffast-math ${CXXFLAGS} -Isim -I. -I"$SRC" \
+    loopy_sim.cpp sim/Sim.cpp PerfCounters.cpp "$SRC/render.cpp" $ENGINE \
+    -o "$OUT/loopy_sim_fastmath" -lm -lpthread
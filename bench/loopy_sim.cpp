@@ -0,0 +1,641 @@
+/*
+  loopy_sim.cpp: runs the looper's render.cpp in the host simulator
+  (sim/Sim.h). Built by ./build.sh next to the benchmark.
+
+  Scenarios:
+    calibrate [samples...]  - latency calibration against simulated round
+                              trips (default: a spread of them), then an
+                              overdub of a burst played back through the
+                              loopback, which must land on the original
+                              burst instead of one round trip late
+    looppoints [samples...] - a first take of a one-bar phrase stopped
+                              this many samples late (negative: early;
+                              default: a spread), which must end up one
+                              bar long when late by more than 1024 and
+                              keep its length otherwise; then a take held
+                              past the end of the buffer, which must close
+                              there with its opening intact
+    session                 - a replayed playing session: a take, overdubs,
+                              a varispeed sweep through reverse, a
+                              multiply and every LFO shape with the knobs
+                              moving; the training run of ./pgo.sh
+    profile                 - render() per sample while a 2s loop plays
+                              at several speeds and while overdubbing:
+                              time and hardware counters (PerfCounters.h)
+    banks                   - two loops in two banks, switched back and
+                              forth: each must come back bit-exact, the
+                              first sample after a switch its first, and a
+                              switch must wait while an overdub runs
+    nonfinite               - NaN and Inf poked into the delay line and an
+                              overdub, which the guards (NonFinite.h) must
+                              clear: every later output sample finite and
+                              the loop clean. Built a second time with
+                              -ffast-math, as the Bela build is, into
+                              loopy_sim_fastmath
+  Add --sync to run auxiliary tasks inline for reproducible runs, and
+  --no-compensation to see layers land one round trip late.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Sim.h"
+#include "DelayEffect.h"
+#include "EngineConfig.h"
+#include "LatencyCalibrator.h"
+#include "LoopBuffer.h"
+#include "LoopPointFinder.h"
+#include "NonFinite.h"
+#include "PerfCounters.h"
+#include "lfo.h"
+
+// from render.cpp
+extern EngineConfig gRuntimeConfig;
+extern LatencyCalibrator gLatencyCalibrator;
+extern int gOverdubOffset;
+extern int gLoopLength;
+extern LoopBuffer* gAudioBuffer;
+extern LoopPointFinder gLoopPointFinder;
+extern DelayEffect delayEffect;
+extern unsigned int gNonFiniteEvents;
+extern int gWritePointer;
+extern bool gRecording;
+extern unsigned int gActiveBank;
+void setLfoShape(unsigned int type);
+bool multiplyLoop(unsigned int times);
+bool selectLoopBank(unsigned int bank);
+
+static const int kRecordPin = 7;
+static const int kClearPin = 10;
+static bool gSyncAux = false;
+static bool gCompensate = true;
+
+static void press(Simulator& sim, int pin, unsigned int holdBlocks = 50)
+{
+    sim.setButton(pin, true);
+    sim.run(holdBlocks);
+    sim.setButton(pin, false);
+    sim.run(holdBlocks);
+}
+
+// A 10ms Hann-windowed 1kHz burst
+static const unsigned int kBurstLength = 441;
+static float burst(uint64_t i)
+{
+    if(i >= kBurstLength)
+        return 0.f;
+    float w = 0.5f - 0.5f * std::cos(2.f * (float)M_PI * i / kBurstLength);
+    return 0.5f * w * std::sin(2.f * (float)M_PI * 1000.f * i / 44100.f);
+}
+
+static std::vector<float> loopWindow(unsigned int start, unsigned int length)
+{
+    std::vector<float> loop(length);
+    gAudioBuffer->copyOut(loop.data(), start, length);
+    return loop;
+}
+
+// Lag of `layer` against `reference` with the strongest correlation
+static int bestLag(const std::vector<float>& layer, const std::vector<float>& reference, int maxLag)
+{
+    int best = 0;
+    double bestC = 0.0;
+    for(int lag = -maxLag; lag <= maxLag; lag++) {
+        double c = 0.0;
+        for(int i = 0; i < (int)layer.size(); i++)
+            if(i - lag >= 0 && i - lag < (int)reference.size())
+                c += (double)layer[i] * reference[i - lag];
+        if(c > bestC) {
+            bestC = c;
+            best = lag;
+        }
+    }
+    return best;
+}
+
+// A take, with loop points settled; returns its samples
+static std::vector<float> take(Simulator& sim, std::function<float(uint64_t)> source, unsigned int blocks)
+{
+    uint64_t takeStart = sim.frames();
+    sim.setSource([=](uint64_t t) { return source(t - takeStart); });
+    press(sim, kRecordPin);
+    sim.run(blocks - 100);
+    press(sim, kRecordPin);
+    sim.setSource(nullptr);
+    for(int i = 0; i < 100; i++) {
+        sim.run(8);
+        Simulator::waitForTasks();
+    }
+    return loopWindow(0, gLoopLength);
+}
+
+static bool calibrate(unsigned int latency)
+{
+    SimConfig config;
+    config.latency = latency;
+    config.threadedAux = !gSyncAux;
+    Simulator sim(config);
+    if(!sim.start())
+        return false;
+    sim.setKnob(0, 0.f);     // dry
+    sim.setKnob(1, 0.f);     // no feedback
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);   // the looper's state outlives a Simulator
+
+    // A loop recorded before calibrating must come through it untouched
+    sim.setLoopbackGain(0.f);
+    std::vector<float> loop = take(sim, [](uint64_t t) { return burst(t % 4410); }, 200);
+    sim.setLoopbackGain(config.loopbackGain);
+
+    // hold Clear, press Record
+    sim.setButton(kClearPin, true);
+    sim.run(50);
+    press(sim, kRecordPin);
+    sim.setButton(kClearPin, false);
+    for(int i = 0; i < 2000 && gLatencyCalibrator.state() != LatencyCalibrator::DONE
+                            && gLatencyCalibrator.state() != LatencyCalibrator::FAILED; i++) {
+        sim.run(8);
+        Simulator::waitForTasks();
+    }
+    sim.run(8);
+    bool measured = gLatencyCalibrator.state() == LatencyCalibrator::DONE;
+    bool kept = gLoopLength == (int)loop.size() && loopWindow(0, gLoopLength) == loop;
+    if(!kept)
+        printf("calibration lost the loop\n");
+    press(sim, kClearPin);
+    int error = gOverdubOffset - (int)latency;
+    if(!gCompensate)
+        gOverdubOffset = 0;
+
+    // First take, with the loopback muted: a burst 0.25s into a 1s loop.
+    // Then one overdub pass with the loopback on: the burst comes back one
+    // round trip late, and compensated it lands on top of the original.
+    uint64_t takeStart = sim.frames() + 200;
+    sim.setLoopbackGain(0.f);
+    sim.setSource([=](uint64_t t) { return t >= takeStart + 11025 ? burst(t - takeStart - 11025) : 0.f; });
+    sim.run(25);
+    press(sim, kRecordPin, 50);
+    sim.run(5512 - 100);
+    press(sim, kRecordPin, 50);
+    // the take starts a little after takeStart; search around the burst
+    unsigned int window = 11025 - 2048;
+    std::vector<float> before = loopWindow(window, 4096 + kBurstLength);
+    sim.setSource(nullptr);
+    sim.setLoopbackGain(config.loopbackGain);
+    press(sim, kRecordPin, 50);
+    sim.run(5512 - 100);
+    press(sim, kRecordPin, 50);
+    std::vector<float> layer = loopWindow(window, 4096 + kBurstLength);
+    for(unsigned int i = 0; i < layer.size(); i++)
+        layer[i] -= before[i];
+    int lag = bestLag(layer, before, 2047);
+    sim.stop();
+
+    // The new layer against the first take: 0 when compensated, one round
+    // trip without. The monitored layer echoes once more a round trip
+    // later, which can pull short round trips off by a sample or two.
+    printf("%10u %10d %10.1f %10d %10d\n", latency, gCompensate ? gOverdubOffset : 0,
+           gLatencyCalibrator.confidence(), error, lag);
+    return measured && kept && std::abs(error) <= 1 && std::abs(lag) <= 2;
+}
+
+// One bar of four notes at different pitches, each decaying into a bed of
+// quiet noise; the noise repeats with the bar too
+static const unsigned int kBar = 4 * 8820;
+static float phrase(uint64_t t)
+{
+    static const float pitches[4] = { 220.f, 277.f, 330.f, 415.f };
+    unsigned int p = (unsigned int)(t % kBar);
+    unsigned int note = p / 8820, i = p % 8820;
+    float env = std::exp(-(float)i / 2000.f);
+    uint32_t h = p * 2654435761u;
+    h ^= h >> 15;
+    float noise = ((h & 0xffff) / 65535.f - 0.5f) * 0.01f;
+    return 0.4f * env * std::sin(2.f * (float)M_PI * pitches[note] * i / 44100.f) + noise;
+}
+
+static bool loopPoints(int late)
+{
+    SimConfig config;
+    config.threadedAux = !gSyncAux;
+    config.loopbackGain = 0.f;
+    Simulator sim(config);
+    if(!sim.start())
+        return false;
+    sim.setKnob(0, 0.f);     // dry
+    sim.setKnob(1, 0.f);     // no feedback
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);   // the looper's state outlives a Simulator
+
+    // record from a bar line, stop `late` samples off the next one
+    uint64_t takeStart = sim.frames();
+    sim.setSource([=](uint64_t t) { return phrase(t - takeStart); });
+    unsigned int blocks = (unsigned int)((int)kBar + late) / config.blockSize;
+    sim.setButton(kRecordPin, true);
+    sim.run(blocks < 50 ? blocks : 50);
+    sim.setButton(kRecordPin, false);
+    sim.run(blocks - 50);
+    press(sim, kRecordPin);
+    int hand = gLoopLength;
+    for(int i = 0; i < 100; i++) {
+        sim.run(8);
+        Simulator::waitForTasks();
+    }
+    int refined = gLoopLength;
+    sim.stop();
+
+    // a take less than an eighth of the finder's window late is kept
+    bool ok = late > 1024 ? std::abs(refined - (int)kBar) <= 2 : refined == hand;
+    printf("%10d %10d %10d %10.2f %10s\n", late, hand, refined, gLoopPointFinder.confidence(), ok ? "ok" : "WRONG");
+    return ok;
+}
+
+// A first take held past the end of the buffer: it must close there, a
+// full buffer long, with its opening intact instead of overwritten
+static bool fullTake()
+{
+    SimConfig config;
+    config.threadedAux = !gSyncAux;
+    config.loopbackGain = 0.f;
+    Simulator sim(config);
+    if(!sim.start())
+        return false;
+    sim.setKnob(0, 0.f);     // dry
+    sim.setKnob(1, 0.f);     // no feedback
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);
+
+    uint64_t takeStart = sim.frames() + 200;
+    sim.setSource([=](uint64_t t) { return t >= takeStart ? burst(t - takeStart) : 0.f; });
+    sim.run(25);
+    press(sim, kRecordPin);
+    unsigned int blocks = 0, limit = gRuntimeConfig.maxLoopSamples / config.blockSize + 1000;
+    while(gRecording && blocks++ < limit)
+        sim.run(1);
+    int length = gLoopLength;
+    std::vector<float> opening = loopWindow(0, 4096);
+    sim.stop();
+
+    double energy = 0.0;
+    for(float x : opening)
+        energy += x * x;
+    bool ok = !gRecording && length == (int)gRuntimeConfig.maxLoopSamples && energy > 1e-3;
+    printf("full take: closed %s after %u blocks, loop %d samples, opening %s\n", gRecording ? "NOT" : "itself",
+           blocks, length, energy > 1e-3 ? "kept" : "LOST");
+    return ok;
+}
+
+// Moves knob `channel` linearly from `from` to `to` over `blocks` blocks
+static void sweep(Simulator& sim, int channel, float from, float to, unsigned int blocks)
+{
+    for(unsigned int b = 0; b < blocks; b += 8) {
+        sim.setKnob(channel, from + (to - from) * b / blocks);
+        sim.run(8);
+    }
+    sim.setKnob(channel, to);
+}
+
+static bool session()
+{
+    SimConfig config;
+    config.threadedAux = !gSyncAux;
+    config.loopbackGain = 0.1f;
+    config.latency = 300;
+    Simulator sim(config);
+    if(!sim.start())
+        return false;
+    const unsigned int second = 44100 / config.blockSize;
+    sim.setKnob(0, 0.3f);    // some delay
+    sim.setKnob(1, 0.4f);    // feedback
+    sim.setKnob(2, 0.2f);    // LFO depth
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);
+
+    // a two-bar take, played back, then two overdubs
+    uint64_t takeStart = sim.frames();
+    sim.setSource([=](uint64_t t) { return phrase(t - takeStart); });
+    press(sim, kRecordPin);
+    sim.run(2 * kBar / config.blockSize - 100);
+    press(sim, kRecordPin);
+    sim.run(2 * second);
+    sim.setSource([=](uint64_t t) { return 0.5f * phrase(2 * (t - takeStart)); });
+    for(int pass = 0; pass < 2; pass++) {
+        press(sim, kRecordPin);
+        sim.run(2 * second);
+        press(sim, kRecordPin);
+        sim.run(second);
+    }
+    sim.setSource(nullptr);
+
+    // varispeed from 2x down through reverse and back, then an overdub
+    // at half speed
+    sweep(sim, 3, 1.f, 0.f, 6 * second);
+    sweep(sim, 3, 0.f, 0.75f, 3 * second);
+    sim.setKnob(3, 0.625f);
+    sim.setSource([=](uint64_t t) { return phrase(t - takeStart); });
+    press(sim, kRecordPin);
+    sim.run(2 * second);
+    press(sim, kRecordPin);
+    sim.setSource(nullptr);
+    sim.setKnob(3, 0.75f);
+
+    multiplyLoop(2);
+    sim.run(2 * second);
+
+    // every LFO shape, with the depth and delay knobs moving
+    for(unsigned int type = 0; type <= MAX_LFOS; type++) {
+        setLfoShape(type);
+        sweep(sim, 2, 0.f, 1.f, second / 2);
+        sweep(sim, 0, 0.3f, 0.8f, second / 2);
+        sim.setKnob(0, 0.3f);
+    }
+    Simulator::waitForTasks();
+    sim.stop();
+
+    const std::vector<float>& out = sim.output();
+    float peak = 0.f;
+    bool finite = true;
+    for(float y : out) {
+        finite = finite && is_finite(y);
+        peak = std::fmax(peak, std::fabs(y));
+    }
+    bool ok = finite && peak > 0.01f && gLoopLength > 0;
+    printf("session: %.1f s rendered, loop %d samples, peak %.2f, %s\n",
+           out.size() / config.sampleRate, gLoopLength, peak, finite ? "finite" : "NOT FINITE");
+    return ok;
+}
+
+// Selects `bank` and runs block by block until it plays. Returns the
+// output index of the first sample played from it, or -1.
+static long switchBank(Simulator& sim, unsigned int bank)
+{
+    if(!selectLoopBank(bank))
+        return -1;
+    for(int i = 0; i < 2000; i++) {
+        size_t start = sim.output().size();
+        sim.run(1);
+        if(gActiveBank == bank)
+            return (long)start;
+        Simulator::waitForTasks();
+    }
+    return -1;
+}
+
+// The loop buffer and `blocks` blocks of output from `start` against `loop`
+static bool sameLoop(Simulator& sim, const std::vector<float>& loop, long start, unsigned int blocks)
+{
+    if(start < 0 || gLoopLength != (int)loop.size() || loopWindow(0, gLoopLength) != loop)
+        return false;
+    sim.run(blocks);
+    const std::vector<float>& out = sim.output();
+    for(size_t i = 0; i < (size_t)blocks * SimConfig().blockSize; i++)
+        if(out[start + i] != loop[i % loop.size()])
+            return false;
+    return true;
+}
+
+static bool banks()
+{
+    SimConfig config;
+    config.threadedAux = !gSyncAux;
+    config.loopbackGain = 0.f;
+    config.noiseLevel = 0.f;
+    Simulator sim(config);
+    if(!sim.start())
+        return false;
+    const unsigned int second = 44100 / config.blockSize;
+    sim.setKnob(0, 0.f);     // dry
+    sim.setKnob(1, 0.f);     // no feedback
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);
+    sim.run(second);         // the spare buffer is mapped by a boot job
+
+    std::vector<float> first = take(sim, phrase, second);
+    long start = switchBank(sim, 1);
+    bool empty = start >= 0 && gLoopLength == 0;
+    std::vector<float> other = take(sim, [](uint64_t t) { return 0.5f * phrase(3 * t); }, 3 * second / 2);
+
+    // no switch while overdubbing; one asked for just before an overdub
+    // starts waits for it to stop
+    press(sim, kRecordPin);
+    bool refused = !selectLoopBank(0);
+    press(sim, kRecordPin);
+    other = loopWindow(0, gLoopLength);
+    bool asked = selectLoopBank(0);
+    sim.setButton(kRecordPin, true);
+    sim.run(50);
+    sim.setButton(kRecordPin, false);
+    for(int i = 0; i < 50; i++) {
+        sim.run(8);
+        Simulator::waitForTasks();
+    }
+    bool deferred = asked && gRecording && gActiveBank == 1;
+    press(sim, kRecordPin);
+    bool backFirst = gActiveBank == 0 && gLoopLength == (int)first.size() && loopWindow(0, gLoopLength) == first;
+
+    // a clean switch each way, heard from the loop's first sample
+    sim.run(second);
+    Simulator::waitForTasks();
+    bool backSecond = sameLoop(sim, other, switchBank(sim, 1), second);
+    Simulator::waitForTasks();
+    backFirst = sameLoop(sim, first, switchBank(sim, 0), second) && backFirst;
+    Simulator::waitForTasks();
+    sim.stop();
+
+    printf("banks: first %zu samples %s, other %zu samples %s; empty bank %s, "
+           "switch while overdubbing %s, asked before one %s\n",
+           first.size(), backFirst ? "bit-exact" : "CHANGED",
+           other.size(), backSecond ? "bit-exact" : "CHANGED",
+           empty ? "empty" : "NOT EMPTY", refused ? "refused" : "NOT REFUSED",
+           deferred ? "deferred" : "NOT DEFERRED");
+    return empty && refused && deferred && backFirst && backSecond;
+}
+
+// NaN into the delay line and Inf into an overdub, then a second of
+// playback. Checked with is_finite(), which -ffast-math leaves alone.
+static bool nonFinite()
+{
+    SimConfig config;
+    config.threadedAux = !gSyncAux;
+    config.loopbackGain = 0.f;
+    Simulator sim(config);
+    if(!sim.start())
+        return false;
+    const unsigned int second = 44100 / config.blockSize;
+    sim.setKnob(0, 0.5f);    // wet
+    sim.setKnob(1, 0.6f);    // feedback
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);
+
+    uint64_t takeStart = sim.frames();
+    sim.setSource([=](uint64_t t) { return phrase(t - takeStart); });
+    press(sim, kRecordPin);
+    sim.run(second);
+    press(sim, kRecordPin);
+    unsigned int delayEvents = delayEffect.recoveries(), loopEvents = gNonFiniteEvents;
+    // the saturator's clip turns NaN into full scale by itself; without it
+    // the NaN reaches the line
+    delayEffect.setSaturation(0.f, 1);
+
+    // overdub, poisoning both between two blocks
+    press(sim, kRecordPin);
+    delayEffect.processSample(NAN);
+    gAudioBuffer->add(gWritePointer, INFINITY);
+    size_t poisoned = sim.output().size();
+    sim.run(50);
+    press(sim, kRecordPin);
+    sim.run(second);
+    Simulator::waitForTasks();
+    sim.stop();
+
+    // the poisoned sample can be heard once, in the block after the poke
+    const std::vector<float>& out = sim.output();
+    bool finite = true;
+    for(size_t i = poisoned + config.blockSize; i < out.size(); i++)
+        finite = finite && is_finite(out[i]);
+    std::vector<float> loop = loopWindow(0, gLoopLength);
+    bool clean = all_finite(loop.data(), (unsigned int)loop.size());
+    bool caught = delayEffect.recoveries() > delayEvents && gNonFiniteEvents > loopEvents;
+    printf("nonfinite: delay recoveries %u, loop events %u, output %s, loop %s\n",
+           delayEffect.recoveries() - delayEvents, gNonFiniteEvents - loopEvents,
+           finite ? "finite" : "NOT FINITE", clean ? "clean" : "NOT CLEAN");
+    return caught && finite && clean;
+}
+
+// render() over `blocks` blocks, per sample
+static void profileRender(Simulator& sim, PerfCounters& counters, const char* name, unsigned int blocks)
+{
+    counters.reset();
+    sim.setCounters(&counters);
+    sim.run(blocks);
+    sim.setCounters(nullptr);
+    double samples = (double)blocks * SimConfig().blockSize;
+    printf("%-16s %9.2f", name, counters.elapsedNs() / samples);
+    for(int e = 0; e < PERF_NUM_EVENTS; e++) {
+        double v = counters.value((PerfEvent)e);
+        if(v < 0.0)
+            printf(" %9s", "-");
+        else
+            printf(" %9.3f", v / samples);
+    }
+    double cycles = counters.value(PERF_CYCLES), instructions = counters.value(PERF_INSTRUCTIONS);
+    if(cycles > 0.0 && instructions >= 0.0)
+        printf(" %6.2f\n", instructions / cycles);
+    else
+        printf(" %6s\n", "-");
+}
+
+static void profile()
+{
+    SimConfig config;
+    config.threadedAux = !gSyncAux;
+    config.loopbackGain = 0.f;
+    Simulator sim(config);
+    if(!sim.start())
+        return;
+    sim.setKnob(0, 0.f);     // dry
+    sim.setKnob(1, 0.f);     // no feedback
+    sim.setKnob(3, 0.75f);   // 1.0x
+    sim.run(100);
+    press(sim, kClearPin);
+
+    uint64_t takeStart = sim.frames();
+    sim.setSource([=](uint64_t t) { return phrase(t - takeStart); });
+    const unsigned int blocks = 2 * 44100 / config.blockSize;
+    sim.setButton(kRecordPin, true);
+    sim.run(50);
+    sim.setButton(kRecordPin, false);
+    sim.run(blocks - 50);
+    press(sim, kRecordPin);
+    Simulator::waitForTasks();
+
+    PerfCounters counters;
+    if(!counters.open())
+        printf("hardware counters unavailable: %s; timing only\n", counters.error());
+    printf("%-16s %9s", "render()", "ns");
+    for(int e = 0; e < PERF_NUM_EVENTS; e++)
+        printf(" %9s", PerfCounters::name((PerfEvent)e));
+    printf(" %6s\n", "IPC");
+
+    static const float speeds[] = { 1.f, 0.5f, 2.f, -1.f, -2.f };
+    for(float speed : speeds) {
+        sim.setKnob(3, (speed + 2.f) / 4.f);
+        sim.run(100);        // let the speed ramp settle
+        char name[32];
+        snprintf(name, sizeof(name), "play %+.1fx", speed);
+        profileRender(sim, counters, name, blocks);
+    }
+    sim.setKnob(3, 0.75f);
+    sim.run(100);
+    press(sim, kRecordPin);
+    profileRender(sim, counters, "overdub +1.0x", blocks);
+    press(sim, kRecordPin);
+    sim.stop();
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> latencies;
+    const char* scenario = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--sync"))
+            gSyncAux = true;
+        else if(!strcmp(argv[i], "--no-compensation"))
+            gCompensate = false;
+        else if(!scenario)
+            scenario = argv[i];
+        else
+            latencies.push_back(atoi(argv[i]));
+    }
+    if(scenario && !strcmp(scenario, "looppoints")) {
+        if(latencies.empty())
+            latencies = { -3000, 0, 500, 1500, 4000, 12000, 20000 };
+        printf("%10s %10s %10s %10s\n", "late", "hand", "refined", "correlation");
+        bool ok = true;
+        for(int late : latencies)
+            ok = loopPoints(late) && ok;
+        ok = fullTake() && ok;
+        printf("%s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    if(scenario && !strcmp(scenario, "session")) {
+        bool ok = session();
+        printf("%s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    if(scenario && !strcmp(scenario, "banks")) {
+        bool ok = banks();
+        printf("%s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    if(scenario && !strcmp(scenario, "nonfinite")) {
+        bool ok = nonFinite();
+        printf("%s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    if(scenario && !strcmp(scenario, "profile")) {
+        profile();
+        return 0;
+    }
+    if(!scenario || strcmp(scenario, "calibrate")) {
+        fprintf(stderr, "usage: %s [--sync] [--no-compensation] calibrate|looppoints|session|banks|nonfinite|profile [samples...]\n", argv[0]);
+        return 1;
+    }
+
+    if(latencies.empty())
+        latencies = { 16, 64, 117, 347, 1000, 2000 };
+    printf("%10s %10s %10s %10s %10s\n", "simulated", "applied", "confidence", "error", "layer lag");
+    bool ok = true;
+    for(int latency : latencies)
+        ok = calibrate((unsigned int)latency) && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
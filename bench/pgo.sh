@@ -0,0 +1,87 @@
+#!/bin/sh
+# Profile-guided build of the benchmark harness and the simulator, and what it gains.
+#
+#   1. a standard build, into pgo/standard
+#   2. an instrumented build, into pgo/build, trained on replayed sessions (loopy_sim
+#      session, looppoints and calibrate) and the benchmark's offline renders of each kernel
+#   3. a rebuild into pgo/build with the profile, which lays out render() and run_lfo()'s
+#      switch around the paths actually taken
+#
+# and then compares bench counters and loopy_sim profile, ns per sample, between the two.
+# Works with g++ (gcov profiles) and clang++ (llvm-profdata; set LLVM_PROFDATA for a
+# versioned one). Run it on the board with CXX=clang++ for the board's profile: the project
+# can then be built with it by adding CPPFLAGS=-fprofile-instr-use=<pgo/profile/loopy.profdata>
+# to the make arguments in settings.json.
+set -e
+cd "$(dirname "$0")"
+PGO="$PWD/pgo"
+PROF="$PGO/profile"
+CXX=${CXX:-g++}
+export CXX
+
+if $CXX --version | grep -q clang; then
+    GENERATE="-fprofile-instr-generate"
+    USE="-fprofile-instr-use=$PROF/loopy.profdata -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date"
+    LLVM_PROFILE_FILE="$PROF/%p-%m.profraw"
+    export LLVM_PROFILE_FILE
+else
+    # the auxiliary task threads update the counts too
+    GENERATE="-fprofile-generate=$PROF -fprofile-update=atomic"
+    USE="-fprofile-use=$PROF -fprofile-correction -Wno-missing-profile"
+fi
+
+rm -rf "$PGO"
+echo "== standard build"
+OUT="$PGO/standard" ./build.sh
+
+echo "== instrumented build and training"
+OUT="$PGO/build" CXXFLAGS="$CXXFLAGS $GENERATE" ./build.sh
+"$PGO/build/loopy_sim" session
+"$PGO/build/loopy_sim" --sync session
+"$PGO/build/loopy_sim" --sync looppoints 4000 20000
+"$PGO/build/loopy_sim" --sync calibrate 117
+"$PGO/build/bench" > /dev/null
+if [ -n "$LLVM_PROFILE_FILE" ]; then
+    ${LLVM_PROFDATA:-llvm-profdata} merge -o "$PROF/loopy.profdata" "$PROF"/*.profraw
+fi
+
+echo "== profile-guided build"
+OUT="$PGO/build" CXXFLAGS="$CXXFLAGS $USE" ./build.sh
+
+# Kernel name and ns per sample of each row of the per-sample tables (name, ns, six
+# counters, IPC)
+rows()
+{
+    "$@" 2>/dev/null | awk 'NF > 8 && $(NF-7) ~ /^[0-9.]+$/ && $NF ~ /^([0-9.]+|-)$/ {
+        name = $1
+        for(i = 2; i <= NF - 8; i++)
+            name = name " " $i
+        printf("%s\t%s\n", name, $(NF-7))
+    }'
+}
+
+# Three runs of each build, taken in turn so that drift in the machine's speed is shared
+: > "$PGO/standard.txt"
+: > "$PGO/build.txt"
+for run in 1 2 3; do
+    for build in standard build; do
+        rows "$PGO/$build/bench" counters >> "$PGO/$build.txt"
+        rows "$PGO/$build/loopy_sim" --sync profile | sed 's/^/render() /' >> "$PGO/$build.txt"
+    done
+done
+
+echo "== gain (ns per sample, best of 3)"
+awk -F '\t' 'NR == FNR {
+        if(!($1 in standard) || $2 < standard[$1])
+            standard[$1] = $2
+        next
+    }
+    !($1 in pgo) { order[n++] = $1 }
+    !($1 in pgo) || $2 < pgo[$1] { pgo[$1] = $2 }
+    END {
+        printf("%-28s %9s %9s %8s\n", "kernel", "standard", "pgo", "gain")
+        for(i = 0; i < n; i++) {
+            k = order[i]
+            printf("%-28s %9.2f %9.2f %+7.1f%%\n", k, standard[k], pgo[k], 100 * (standard[k] - pgo[k]) / standard[k])
+        }
+    }' "$PGO/standard.txt" "$PGO/build.txt"
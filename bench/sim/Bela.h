@@ -0,0 +1,92 @@
+/*
+  Bela.h for the host simulator (see Sim.h): just the parts of the Bela API
+  the looper uses, with the same names and semantics. Buffers are
+  interleaved; digital frames carry pin values in bits 16..31.
+*/
+
+#ifndef BELA_SIM_H
+#define BELA_SIM_H
+
+#include <cstdio>
+#include <stdint.h>
+
+#define BELA_AUDIO_PRIORITY 95
+#define INPUT  0
+#define OUTPUT 1
+#define LOW    0
+#define HIGH   1
+
+struct BelaContext {
+    float* audioIn;
+    float* audioOut;
+    float* analogIn;
+    float* analogOut;
+    uint32_t* digital;
+    uint32_t audioFrames;
+    uint32_t audioInChannels;
+    uint32_t audioOutChannels;
+    float audioSampleRate;
+    uint32_t analogFrames;
+    uint32_t analogInChannels;
+    uint32_t analogOutChannels;
+    float analogSampleRate;
+    uint32_t digitalFrames;
+    uint32_t digitalChannels;
+    float digitalSampleRate;
+    uint64_t audioFramesElapsed;
+};
+
+typedef void* AuxiliaryTask;
+
+AuxiliaryTask Bela_createAuxiliaryTask(void (*callback)(void*), int priority, const char* name, void* arg = 0);
+int Bela_scheduleAuxiliaryTask(AuxiliaryTask task);
+int Bela_stopRequested();
+
+#define rt_printf printf
+
+static inline float audioRead(BelaContext* context, int frame, int channel)
+{
+    return context->audioIn[frame * context->audioInChannels + channel];
+}
+
+static inline void audioWrite(BelaContext* context, int frame, int channel, float value)
+{
+    context->audioOut[frame * context->audioOutChannels + channel] = value;
+}
+
+static inline float analogRead(BelaContext* context, int frame, int channel)
+{
+    return context->analogIn[frame * context->analogInChannels + channel];
+}
+
+static inline int digitalRead(BelaContext* context, int frame, int channel)
+{
+    return (context->digital[frame] >> (channel + 16)) & 1;
+}
+
+static inline void digitalWrite(BelaContext* context, int frame, int channel, int value)
+{
+    for(uint32_t f = frame; f < context->digitalFrames; f++) {
+        if(value)
+            context->digital[f] |= 1u << (channel + 16);
+        else
+            context->digital[f] &= ~(1u << (channel + 16));
+    }
+}
+
+static inline void pinMode(BelaContext* context, int frame, int channel, int mode)
+{
+    for(uint32_t f = frame; f < context->digitalFrames; f++) {
+        if(mode == INPUT)
+            context->digital[f] |= 1u << channel;
+        else
+            context->digital[f] &= ~(1u << channel);
+    }
+}
+
+// Implemented by render.cpp
+bool setup(BelaContext* context, void* userData);
+void render(BelaContext* context, void* userData);
+void cleanup(BelaContext* context, void* userData);
+
+#endif
@@ -0,0 +1,235 @@
+#include "Sim.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Simd.h"
+#include "../PerfCounters.h"
+
+// ------------------------------------------------------
+// Auxiliary tasks
+
+namespace {
+
+struct Task {
+    void (*callback)(void*);
+    void* arg;
+    unsigned int pending;
+    bool running;
+};
+
+std::mutex gTaskMutex;
+std::condition_variable gTaskWake;
+std::condition_variable gTaskIdle;
+std::vector<std::unique_ptr<Task>> gTasks;
+std::vector<std::thread> gTaskThreads;
+bool gThreaded = true;
+bool gStopTasks = false;
+
+void taskThread(Task* task)
+{
+    std::unique_lock<std::mutex> lock(gTaskMutex);
+    for(;;) {
+        gTaskWake.wait(lock, [&] { return task->pending || gStopTasks; });
+        if(!task->pending)
+            break;
+        task->pending--;
+        task->running = true;
+        lock.unlock();
+        task->callback(task->arg);
+        lock.lock();
+        task->running = false;
+        gTaskIdle.notify_all();
+    }
+}
+
+void stopTasks()
+{
+    {
+        std::lock_guard<std::mutex> lock(gTaskMutex);
+        gStopTasks = true;
+    }
+    gTaskWake.notify_all();
+    for(auto& t : gTaskThreads)
+        t.join();
+    gTaskThreads.clear();
+    gTasks.clear();
+    gStopTasks = false;
+}
+
+} // namespace
+
+AuxiliaryTask Bela_createAuxiliaryTask(void (*callback)(void*), int, const char*, void* arg)
+{
+    std::lock_guard<std::mutex> lock(gTaskMutex);
+    gTasks.emplace_back(new Task{ callback, arg, 0, false });
+    Task* task = gTasks.back().get();
+    if(gThreaded)
+        gTaskThreads.emplace_back(taskThread, task);
+    return task;
+}
+
+int Bela_scheduleAuxiliaryTask(AuxiliaryTask t)
+{
+    Task* task = static_cast<Task*>(t);
+    {
+        std::lock_guard<std::mutex> lock(gTaskMutex);
+        // like the board's task queue: one run per request
+        task->pending++;
+    }
+    if(gThreaded)
+        gTaskWake.notify_all();
+    return 0;
+}
+
+int Bela_stopRequested()
+{
+    return 0;
+}
+
+void Simulator::runPendingTasks()
+{
+    if(gThreaded)
+        return;
+    for(bool ran = true; ran; ) {
+        ran = false;
+        for(auto& task : gTasks) {
+            while(task->pending) {
+                task->pending--;
+                task->callback(task->arg);
+                ran = true;
+            }
+        }
+    }
+}
+
+void Simulator::waitForTasks()
+{
+    if(!gThreaded) {
+        runPendingTasks();
+        return;
+    }
+    std::unique_lock<std::mutex> lock(gTaskMutex);
+    gTaskIdle.wait(lock, [] {
+        for(auto& task : gTasks)
+            if(task->pending || task->running)
+                return false;
+        return true;
+    });
+}
+
+// ------------------------------------------------------
+// Simulator
+
+Simulator::Simulator(const SimConfig& c)
+    : config(c)
+    , counters(nullptr)
+    , buttons(0)
+    , noiseState(vrandom_seed(1, 0))
+    , started(false)
+{
+    if(config.latency && config.latency < config.blockSize)
+        config.latency = config.blockSize;   // the output of a block is heard from the next one
+
+    std::memset(&context, 0, sizeof(context));
+    context.audioFrames = config.blockSize;
+    context.audioInChannels = 2;
+    context.audioOutChannels = 2;
+    context.audioSampleRate = config.sampleRate;
+    context.analogFrames = config.blockSize / 2;
+    context.analogInChannels = 8;
+    context.analogOutChannels = 8;
+    context.analogSampleRate = config.sampleRate / 2;
+    context.digitalFrames = config.blockSize;
+    context.digitalChannels = 16;
+    context.digitalSampleRate = config.sampleRate;
+
+    audioIn.assign(context.audioFrames * context.audioInChannels, 0.f);
+    audioOut.assign(context.audioFrames * context.audioOutChannels, 0.f);
+    analogIn.assign(context.analogFrames * context.analogInChannels, 0.f);
+    analogOut.assign(context.analogFrames * context.analogOutChannels, 0.f);
+    digital.assign(context.digitalFrames, 0);
+    context.audioIn = audioIn.data();
+    context.audioOut = audioOut.data();
+    context.analogIn = analogIn.data();
+    context.analogOut = analogOut.data();
+    context.digital = digital.data();
+
+    loopback.assign(config.latency + config.blockSize, 0.f);
+}
+
+Simulator::~Simulator()
+{
+    stop();
+}
+
+bool Simulator::start()
+{
+    gThreaded = config.threadedAux;
+    started = setup(&context, nullptr);
+    return started;
+}
+
+void Simulator::setButton(int pin, bool down)
+{
+    if(down)
+        buttons |= 1u << (pin + 16);
+    else
+        buttons &= ~(1u << (pin + 16));
+}
+
+void Simulator::setKnob(int channel, float value)
+{
+    for(uint32_t f = 0; f < context.analogFrames; f++)
+        analogIn[f * context.analogInChannels + channel] = value;
+}
+
+void Simulator::run(unsigned int blocks)
+{
+    const unsigned int ring = (unsigned int)loopback.size();
+    for(unsigned int b = 0; b < blocks; b++) {
+        uint64_t t0 = context.audioFramesElapsed;
+        for(uint32_t n = 0; n < context.audioFrames; n++) {
+            uint64_t t = t0 + n;
+            float x = source ? source(t) : 0.f;
+            if(config.latency && t >= config.latency)
+                x += config.loopbackGain * loopback[(t - config.latency) % ring];
+            x += config.noiseLevel * 3.4641f * (vrandom(noiseState) - 0.5f);  // uniform, RMS noiseLevel
+            for(uint32_t c = 0; c < context.audioInChannels; c++)
+                audioIn[n * context.audioInChannels + c] = x;
+        }
+        // inputs drive their pins; outputs keep what render() wrote
+        for(uint32_t f = 0; f < context.digitalFrames; f++) {
+            uint32_t inputs = (digital[f] & 0xffff) << 16;
+            digital[f] = (digital[f] & ~inputs) | (buttons & inputs);
+        }
+        std::fill(audioOut.begin(), audioOut.end(), 0.f);
+
+        if(counters)
+            counters->start();
+        render(&context, nullptr);
+        if(counters)
+            counters->stop();
+
+        for(uint32_t n = 0; n < context.audioFrames; n++) {
+            float y = audioOut[n * context.audioOutChannels];
+            loopback[(t0 + n) % ring] = y;
+            recorded.push_back(y);
+        }
+        context.audioFramesElapsed += context.audioFrames;
+        runPendingTasks();
+    }
+}
+
+void Simulator::stop()
+{
+    if(!started)
+        return;
+    cleanup(&context, nullptr);
+    waitForTasks();
+    stopTasks();
+    started = false;
+}
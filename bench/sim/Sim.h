@@ -0,0 +1,72 @@
+/*
+  Sim.h: host simulator for the Bela project. Runs the real setup(),
+  render() and cleanup() from render.cpp block by block on a desktop, with
+  the buttons, knobs and microphone driven by code, and optionally an
+  acoustic loopback from the output back into the input after a given
+  round-trip latency. Auxiliary tasks run on threads, as on the board, or
+  inline after each block for reproducible runs.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include "Bela.h"
+
+class PerfCounters;
+
+struct SimConfig {
+    unsigned int blockSize = 8;      // -p 8
+    float sampleRate = 44100.f;
+    unsigned int latency = 0;        // round trip, in samples; 0 = no loopback
+    float loopbackGain = 0.5f;
+    float noiseLevel = 0.001f;       // input noise floor, RMS
+    bool threadedAux = true;
+};
+
+class Simulator {
+public:
+    explicit Simulator(const SimConfig& config);
+    ~Simulator();
+
+    bool start();                    // setup()
+    void run(unsigned int blocks);   // render() blocks
+    void stop();                     // cleanup(), then waits for auxiliary tasks
+
+    // Inputs, held until changed
+    void setButton(int pin, bool down);
+    void setKnob(int channel, float value);
+    void setLoopbackGain(float gain) { config.loopbackGain = gain; }
+    // Microphone signal by absolute frame; added to the loopback
+    void setSource(std::function<float(uint64_t)> source) { this->source = source; }
+
+    uint64_t frames() const { return context.audioFramesElapsed; }
+    // Output of every block run so far, channel 0
+    const std::vector<float>& output() const { return recorded; }
+
+    // Start and stop `counters` (PerfCounters.h) around each render() call,
+    // so they count render() alone; nullptr for none
+    void setCounters(PerfCounters* counters) { this->counters = counters; }
+
+    // Run any inline auxiliary tasks now (threadedAux == false)
+    static void runPendingTasks();
+    // Wait until the auxiliary task threads are idle
+    static void waitForTasks();
+
+private:
+    SimConfig config;
+    BelaContext context;
+    std::vector<float> audioIn, audioOut, analogIn, analogOut;
+    std::vector<uint32_t> digital;
+    std::vector<float> loopback;     // ring of past output, for the loopback
+    std::vector<float> recorded;
+    std::function<float(uint64_t)> source;
+    PerfCounters* counters;
+    uint32_t buttons;
+    uint32_t noiseState;
+    bool started;
+};
+
+#endif